@@ -5,6 +5,7 @@
 #include "goober/core.hh"
 #include "goober/draw.hh"
 #include "goober/font.hh"
+#include "goober/image.hh"
 #include "goober/widgets.hh"
 
 #include <GL/glew.h>
@@ -18,11 +19,12 @@ static constexpr char vertexSource[] =
     "layout(location = 0) in vec2 in_pos;\n"
     "layout(location = 1) in vec2 in_uv;\n"
     "layout(location = 2) in vec4 in_rgba;\n"
+    "uniform vec4 in_color;\n"
     "out vec4 attr_rgba;\n"
     "out vec2 attr_uv;\n"
     "void main() {\n"
     "    gl_Position = vec4(in_pos.x / 400.0f - 1, (600.0f - in_pos.y) / 300.0f - 1, 0, 1);\n"
-    "    attr_rgba = in_rgba;\n"
+    "    attr_rgba = in_rgba * in_color;\n"
     "    attr_uv = in_uv;\n"
     "}\n";
 static constexpr int vertexLength = sizeof(vertexSource);
@@ -59,6 +61,15 @@ int main(int argc, char* argv[]) {
     auto [rs, ctx] = grCreateContext();
     auto [rs2, font] = grCreateDefaultFont(ctx);
 
+    // a small checkerboard drawn from the image atlas
+    unsigned char checker[8 * 8 * 4];
+    for (int index = 0; index != 8 * 8; ++index) {
+        unsigned char const shade = (index % 8 + index / 8) % 2 != 0 ? 0xFF : 0x40;
+        for (int channel = 0; channel != 4; ++channel)
+            checker[index * 4 + channel] = shade;
+    }
+    grImageId const checkerImage = grAddImage(ctx, checker, 8, 8).value;
+
     GLuint fontTexture = 0;
     glGenTextures(1, &fontTexture);
 
@@ -111,6 +122,32 @@ int main(int argc, char* argv[]) {
         (void*)offsetof(grDrawList::Vertex, rgba));
     glEnableVertexArrayAttrib(vao, 2);
 
+    // uniform color draw lists have no per-vertex color; the disabled attribute
+    // reads as constant white and the command color arrives through in_color
+    GLuint compactVao = 0;
+    glGenVertexArrays(1, &compactVao);
+    glBindVertexArray(compactVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(
+        0,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(grDrawList::CompactVertex),
+        (void*)offsetof(grDrawList::CompactVertex, pos));
+    glEnableVertexArrayAttrib(compactVao, 0);
+
+    glVertexAttribPointer(
+        1,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(grDrawList::CompactVertex),
+        (void*)offsetof(grDrawList::CompactVertex, uv));
+    glEnableVertexArrayAttrib(compactVao, 1);
+    glVertexAttrib4f(2, 1.f, 1.f, 1.f, 1.f);
+
     GLuint program = glCreateProgram();
     {
         GLchar const* source = vertexSource;
@@ -128,7 +165,10 @@ int main(int argc, char* argv[]) {
         glLinkProgram(program);
     }
     GLint texLoc = glGetUniformLocation(program, "in_tex");
+    GLint colorLoc = glGetUniformLocation(program, "in_color");
 
+    unsigned int fontTextureWidth = 0;
+    unsigned int fontTextureHeight = 0;
     if (grFontAtlas const* atlas = grGetFontAtlasIfDirtyAlpha8(ctx)) {
         glBindTexture(GL_TEXTURE_2D, fontTexture);
         GLenum const format = atlas->bpp == 8 ? GL_RED : GL_RGBA;
@@ -142,6 +182,8 @@ int main(int argc, char* argv[]) {
             format,
             GL_UNSIGNED_BYTE,
             atlas->data);
+        fontTextureWidth = atlas->width;
+        fontTextureHeight = atlas->height;
         grFontAtlasBindTexture(ctx, fontTexture);
     }
 
@@ -181,14 +223,91 @@ int main(int argc, char* argv[]) {
         grBeginFrame(ctx, 0.f);
 
         grBeginPortal(ctx, "Test");
+        grCurrentDrawList(ctx)->uniformColor = true;
         grText(ctx, "hello world!", {40, 40}, grColors::white);
         if (grButton(ctx, "exit", {240, 240}, grColors::darkgrey))
             running = false;
         grImage(ctx, 0, {{400, 300}, {500, 400}}, {{0, 1}, {1, 0}}, grColors::white);
+        grImage(ctx, checkerImage, {{560, 300}, {640, 380}}, grColors::white);
 
         grEndPortal(ctx);
 
-        grEndFrame(ctx);
+        grFrameStatus frameStatus;
+        grEndFrame(ctx, &frameStatus);
+
+        // image pages are uploaded whole when they change; an image resolved before its page
+        // had a texture is skipped, and the frame requested in its place draws it
+        for (unsigned int index = 0; index != ctx->imageAtlas->pages.size(); ++index) {
+            grImageAtlasPage const* page = grGetImageAtlasPageIfDirty(ctx, index);
+            if (page == nullptr)
+                continue;
+
+            GLuint texture = static_cast<GLuint>(page->texture);
+            if (texture == 0)
+                glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                GL_RGBA,
+                page->size,
+                page->size,
+                0,
+                GL_RGBA,
+                GL_UNSIGNED_BYTE,
+                page->pixels);
+            grImageAtlasBindTexture(ctx, index, texture);
+        }
+
+        // sleep until input arrives unless a widget asked to animate
+        if (!frameStatus.changed) {
+            if (frameStatus.nextWakeup < 0.f)
+                SDL_WaitEvent(nullptr);
+            else if (frameStatus.nextWakeup > 0.f)
+                SDL_WaitEventTimeout(nullptr, static_cast<int>(frameStatus.nextWakeup * 1000.f));
+            continue;
+        }
+
+        // glyphs added since the last upload only need their own areas copied, unless the
+        // atlas grew and the texture must be replaced
+        if (grFontAtlas const* atlas = grGetFontAtlasIfDirtyAlpha8(ctx)) {
+            glBindTexture(GL_TEXTURE_2D, fontTexture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas->width);
+            if (atlas->width != fontTextureWidth || atlas->height != fontTextureHeight) {
+                glTexImage2D(
+                    GL_TEXTURE_2D,
+                    0,
+                    GL_RED,
+                    atlas->width,
+                    atlas->height,
+                    0,
+                    GL_RED,
+                    GL_UNSIGNED_BYTE,
+                    atlas->data);
+                fontTextureWidth = atlas->width;
+                fontTextureHeight = atlas->height;
+            }
+            else {
+                for (grRect const& rect : atlas->dirtyRects) {
+                    int const x = static_cast<int>(rect.minimum.x);
+                    int const y = static_cast<int>(rect.minimum.y);
+                    glTexSubImage2D(
+                        GL_TEXTURE_2D,
+                        0,
+                        x,
+                        y,
+                        static_cast<int>(rect.size().x),
+                        static_cast<int>(rect.size().y),
+                        GL_RED,
+                        GL_UNSIGNED_BYTE,
+                        atlas->data + y * atlas->width + x);
+                }
+            }
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            grFontAtlasBindTexture(ctx, fontTexture);
+        }
 
         glViewport(0, 0, width, height);
         glClearColor(0.3f, 0.3f, 0.3f, 0.f);
@@ -204,15 +323,26 @@ int main(int argc, char* argv[]) {
         glBlendEquation(GL_FUNC_ADD);
         glBlendFunc(GL_SRC_COLOR, GL_ONE_MINUS_SRC_ALPHA);
 
-        for (grPortal* port : ctx->portals) {
-            grDrawList const& draw = *port->draw;
+        grDrawData const* data = grGetDrawData(ctx);
+        for (grDrawList const& draw : data->lists) {
+            bool const compact = !draw.compactVertices.empty();
+            glBindVertexArray(compact ? compactVao : vao);
 
             glBindBuffer(GL_ARRAY_BUFFER, vbo);
-            glBufferSubData(
-                GL_ARRAY_BUFFER,
-                0,
-                draw.vertices.size() * sizeof(grDrawList::Vertex),
-                draw.vertices.data());
+            if (compact) {
+                glBufferSubData(
+                    GL_ARRAY_BUFFER,
+                    0,
+                    draw.compactVertices.size() * sizeof(grDrawList::CompactVertex),
+                    draw.compactVertices.data());
+            }
+            else {
+                glBufferSubData(
+                    GL_ARRAY_BUFFER,
+                    0,
+                    draw.vertices.size() * sizeof(grDrawList::Vertex),
+                    draw.vertices.data());
+            }
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
             glBufferSubData(
@@ -222,8 +352,24 @@ int main(int argc, char* argv[]) {
                 draw.indices.data());
 
             for (grDrawList::Command const& cmd : draw.commands) {
+                if (cmd.callback != nullptr) {
+                    cmd.callback(cmd.callbackUserData, draw, cmd);
+
+                    // the callback may have changed any state
+                    glBindVertexArray(compact ? compactVao : vao);
+                    glUseProgram(program);
+                    glActiveTexture(GL_TEXTURE0);
+                    continue;
+                }
+
                 glBindTexture(GL_TEXTURE_2D, cmd.textureId);
                 glBindSampler(0, fontSampler);
+                glUniform4f(
+                    colorLoc,
+                    cmd.color.r / 255.f,
+                    cmd.color.g / 255.f,
+                    cmd.color.b / 255.f,
+                    cmd.color.a / 255.f);
                 glDrawElements(
                     GL_TRIANGLES,
                     cmd.indexCount,
@@ -6,6 +6,7 @@
 #define GOOBER_CORE_HH_
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -29,8 +30,15 @@ inline namespace goober {
     struct grContext;
     struct grFont;
     struct grFontAtlas;
+    struct grTextCache;
+    struct grCachedText;
+    struct grTextRun;
+    struct grImageAtlas;
+    struct grCircleTable;
     struct grPortal;
+    struct grPortalBuilder;
     struct grDrawList;
+    struct grDrawData;
 
     // ------------------------------------------------------
     //  * miscellaneous public types *
@@ -45,6 +53,9 @@ inline namespace goober {
     /// @brief Font id.
     using grFontId = std::uint64_t;
 
+    /// @brief Id of an image registered with the image atlas; 0 is never a valid id.
+    using grImageId = std::uint64_t;
+
     // ------------------------------------------------------
     //  * component-wise vectors *
     // ------------------------------------------------------
@@ -130,6 +141,11 @@ inline namespace goober {
             , g(gi)
             , b(bi)
             , a(ai) {}
+
+        constexpr friend bool operator==(grColor l, grColor r) noexcept {
+            return l.r == r.r && l.g == r.g && l.b == r.b && l.a == r.a;
+        }
+        constexpr friend bool operator!=(grColor l, grColor r) noexcept { return !(l == r); }
     };
 
     namespace grColors {
@@ -222,6 +238,27 @@ inline namespace goober {
 
         inline reference push_back(const_reference value);
 
+        /// @brief Grows the array without initializing the new elements.
+        /// @param count Number of elements to append.
+        /// @return Pointer to the first appended element.
+        inline pointer append_uninitialized(size_type count);
+
+        /// @brief Uses caller-owned memory as the array's storage.
+        /// The array never frees attached memory; growing past capacity moves
+        /// the contents into goober-owned memory instead.
+        /// @param storage Memory for at least capacity elements.
+        /// @param capacity Number of elements that fit in storage.
+        inline void attach(pointer storage, size_type capacity);
+
+        /// @brief Empties the array and forgets any storage attached with attach().
+        inline void detach() noexcept;
+
+        /// @brief Checks if the array is using caller-owned memory.
+        /// @return True if storage was attached with attach().
+        bool borrowed() const noexcept { return _borrowed; }
+
+        inline void swap(grArray& other) noexcept;
+
         iterator begin() noexcept { return _data; }
         const_iterator begin() const noexcept { return _data; }
 
@@ -229,11 +266,13 @@ inline namespace goober {
         const_iterator end() const noexcept { return _sentinel; }
 
     private:
+        inline void _grow(size_type minCapacity);
         inline void _reallocate(size_type newCapacity);
 
         T* _data = nullptr;
         T* _sentinel = nullptr;
         T* _reserved = nullptr;
+        bool _borrowed = false;
     };
 
     // ------------------------------------------------------
@@ -306,6 +345,7 @@ inline namespace goober {
         InvalidId,
         BadAlloc,
         Empty,
+        Unsupported,
     };
 
     /// @brief Simple wrapper for functions that can return a value or failure status code.
@@ -365,6 +405,21 @@ inline namespace goober {
         return static_cast<grButtonMask>(static_cast<uint16_t>(l) & static_cast<uint16_t>(r));
     }
 
+    // ------------------------------------------------------
+    //  * grFrameStatus frame summary *
+    // ------------------------------------------------------
+
+    /// @brief Tells the application whether and when another frame is needed.
+    struct grFrameStatus {
+        /// @brief True if the frame draws differently from the previous one.
+        bool changed = true;
+        /// @brief True if a widget asked to be updated again without new input.
+        bool animating = false;
+        /// @brief Seconds until the next frame should run, or a negative value if the
+        /// application can wait for input.
+        float nextWakeup = -1.f;
+    };
+
     // ------------------------------------------------------
     //  * grContext core goober state *
     // ------------------------------------------------------
@@ -387,6 +442,28 @@ inline namespace goober {
         grPortal* currentPortal = nullptr;
         grDrawList* currentDrawList = nullptr;
         grFontAtlas* fontAtlas = nullptr;
+        /// @brief Null in builder contexts, which measure text without caching.
+        grTextCache* textCache = nullptr;
+        /// @brief Scratch run reused by widgets that lay out and draw a label.
+        grBoxed<grTextRun> textRun;
+        grImageAtlas* imageAtlas = nullptr;
+        grCircleTable* circleTable = nullptr;
+        grArray<grPortalBuilder*> builders;
+        grContext* parent = nullptr;
+        std::uint64_t frame = 0;
+        /// @brief Shortest delay requested by grRequestAnimation this frame; negative if none.
+        float animationDelay = -1.f;
+
+        // triple-buffered frame output; the building slot belongs to the UI
+        // thread, the consuming slot to the thread calling grGetDrawData, and
+        // drawDataReady holds the most recently published slot
+        static constexpr unsigned drawDataFresh = 0x4;
+        grDrawData* drawData[3] = {};
+        unsigned drawDataBuilding = 0;
+        unsigned drawDataConsuming = 1;
+        std::atomic<unsigned> drawDataReady{2};
+        /// @brief Slot published by the last grEndFrame, which the next one compares against.
+        unsigned drawDataPublished = 2;
     };
 
     // ------------------------------------------------------
@@ -400,6 +477,20 @@ inline namespace goober {
         grArray<grId> idStack;
     };
 
+    // ------------------------------------------------------
+    //  * grPortalBuilder parallel portal construction *
+    // ------------------------------------------------------
+
+    /// @brief Handle for building one portal on a worker thread.
+    /// Widgets are submitted through the builder's own context, which shares fonts
+    /// and input with its parent but has a private portal stack and active id.
+    /// Changes to the active id are merged back into the parent by grEndFrame.
+    struct grPortalBuilder {
+        grContext context;
+        grPortal* portal = nullptr;
+        grId activeIdStart = {};
+    };
+
     // ------------------------------------------------------
     //  * miscellaneous helper functions *
     // ------------------------------------------------------
@@ -411,7 +502,7 @@ inline namespace goober {
     constexpr std::uint64_t grHashFnv1a(char const* data, std::size_t length) noexcept {
         std::uint64_t state = 14695981039346656037ull;
         for (size_t index = 0; index != length; ++index)
-            state = (state ^ data[length]) * 1099511628211ull;
+            state = (state ^ static_cast<unsigned char>(data[index])) * 1099511628211ull;
         return state;
     }
 
@@ -457,10 +548,38 @@ inline namespace goober {
     GOOBER_API grStatus grEndPortal(grContext* context);
     GOOBER_API grPortal* grCurrentPortal(grContext* context);
 
+    /// @brief Creates a builder for filling a portal from another thread.
+    /// Must be called on the thread that owns the context, between grBeginFrame and
+    /// grEndFrame. Each builder may then be used by one thread at a time, and all work
+    /// on it must finish before grEndFrame, which releases it. Nested portals cannot be
+    /// begun on a builder's context, and images registered with grAddImage cannot be drawn
+    /// from it, since it has no image atlas. Fails with Unsupported when another builder
+    /// holds the portal, it is open on the context's portal stack, or the font atlas is
+    /// dynamic; grBeginPortal likewise fails while a builder holds it.
+    /// @param context Context owning the portal.
+    /// @param name Name of the portal to build.
+    /// @return Builder whose context is passed to widgets on the worker thread.
+    GOOBER_API grResult<grPortalBuilder*> grCreatePortalBuilder(
+        grContext* context,
+        grStringView name);
+
     GOOBER_API grDrawList* grCurrentDrawList(grContext* context);
 
     GOOBER_API grStatus grBeginFrame(grContext* context, float deltaTime);
-    GOOBER_API grStatus grEndFrame(grContext* context);
+
+    /// @brief Finishes the frame and publishes its draw data.
+    /// @param status Receives whether the frame changed and when the next one is needed.
+    GOOBER_API grStatus grEndFrame(grContext* context, grFrameStatus* status = nullptr);
+
+    /// @brief Asks for another frame even if no input arrives, such as for a blinking caret.
+    /// @param delay Seconds from the end of this frame until the next one is needed.
+    GOOBER_API grStatus grRequestAnimation(grContext* context, float delay = 0.f);
+
+    /// @brief Retrieves the draw data most recently published by grEndFrame.
+    /// May be called from a thread other than the one building the UI.
+    /// @return Snapshot that remains valid until the next call, or nullptr if no frame
+    /// has been published yet.
+    GOOBER_API grDrawData const* grGetDrawData(grContext* context);
 
     GOOBER_API grId grGetId(grContext const* context, uint64_t hash) noexcept;
     inline grId grGetId(grContext const* context, void const* ptr) noexcept {
@@ -519,8 +638,10 @@ inline namespace goober {
     grArray<T>::grArray(grArray&& rhs) noexcept
         : _data(rhs._data)
         , _sentinel(rhs._sentinel)
-        , _reserved(rhs._reserved) {
+        , _reserved(rhs._reserved)
+        , _borrowed(rhs._borrowed) {
         rhs._data = rhs._sentinel = rhs._reserved = nullptr;
+        rhs._borrowed = false;
     }
 
     template <typename T>
@@ -532,9 +653,10 @@ inline namespace goober {
             _data = rhs._data;
             _sentinel = rhs._sentinel;
             _reserved = rhs._reserved;
-            _allocator = rhs._allocator;
+            _borrowed = rhs._borrowed;
 
             rhs._data = rhs._sentinel = rhs._reserved = nullptr;
+            rhs._borrowed = false;
         }
         return *this;
     }
@@ -581,8 +703,10 @@ inline namespace goober {
     template <typename T>
     void grArray<T>::shrink_to_fit() {
         if (_data == _sentinel) {
-            grFree(_data);
+            if (!_borrowed)
+                grFree(_data);
             _data = _sentinel = _reserved = nullptr;
+            _borrowed = false;
         }
         else if (_sentinel != _reserved) {
             _reallocate(_sentinel - _data);
@@ -594,22 +718,80 @@ inline namespace goober {
         if (_sentinel != _reserved)
             return *new (_sentinel++) T(value);
 
-        auto constexpr minCapacity = 8;
-        auto const size = _sentinel - _data;
-        auto const newCapacity =
-            size < minCapacity ? minCapacity : /*1.5 * size*/ (size + (size >> 1));
-
         if constexpr (std::is_nothrow_move_constructible_v<T>) {
-            _reallocate(newCapacity);
+            _grow(size() + 1);
             return *new (_sentinel++) T(value);
         }
         else {
             auto tmp(value);
-            _reallocate(newCapacity);
+            _grow(size() + 1);
             return *new (_sentinel++) T(static_cast<reference&&>(tmp));
         }
     }
 
+    template <typename T>
+    auto grArray<T>::append_uninitialized(size_type count) -> pointer {
+        static_assert(
+            std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+            "append_uninitialized requires a trivial element type");
+
+        if (static_cast<size_type>(_reserved - _sentinel) < count)
+            _grow(size() + count);
+
+        pointer const first = _sentinel;
+        _sentinel += count;
+        return first;
+    }
+
+    template <typename T>
+    void grArray<T>::_grow(size_type minCapacity) {
+        size_type constexpr smallCapacity = 8;
+        size_type const size = _sentinel - _data;
+        size_type newCapacity =
+            size < smallCapacity ? smallCapacity : /*1.5 * size*/ (size + (size >> 1));
+        if (newCapacity < minCapacity)
+            newCapacity = minCapacity;
+
+        _reallocate(newCapacity);
+    }
+
+    template <typename T>
+    void grArray<T>::swap(grArray& other) noexcept {
+        T* const data = _data;
+        T* const sentinel = _sentinel;
+        T* const reserved = _reserved;
+        bool const borrowed = _borrowed;
+
+        _data = other._data;
+        _sentinel = other._sentinel;
+        _reserved = other._reserved;
+        _borrowed = other._borrowed;
+
+        other._data = data;
+        other._sentinel = sentinel;
+        other._reserved = reserved;
+        other._borrowed = borrowed;
+    }
+
+    template <typename T>
+    void grArray<T>::attach(pointer storage, size_type capacity) {
+        resize(0);
+        shrink_to_fit();
+
+        _data = _sentinel = storage;
+        _reserved = storage + capacity;
+        _borrowed = true;
+    }
+
+    template <typename T>
+    void grArray<T>::detach() noexcept {
+        resize(0);
+        if (_borrowed) {
+            _data = _sentinel = _reserved = nullptr;
+            _borrowed = false;
+        }
+    }
+
     template <typename T>
     void grArray<T>::_reallocate(size_type newCapacity) {
         grArray<T> tmp = static_cast<grArray<T>&&>(*this);
@@ -10,13 +10,57 @@
 
 inline namespace goober {
 
+    // ------------------------------------------------------
+    //  * grCircleTable curve tessellation tables *
+    // ------------------------------------------------------
+
+    /// @brief Precomputed unit-circle points for tessellating curves without trig calls.
+    /// Holds one table for every segment count that is a multiple of 4 up to maxSegments,
+    /// each starting at angle 0 and advancing clockwise on screen.
+    struct grCircleTable {
+        static constexpr int segmentStep = 4;
+        static constexpr int maxSegments = 64;
+        static constexpr int tableCount = maxSegments / segmentStep;
+        static constexpr int pointCount = segmentStep * tableCount * (tableCount + 1) / 2;
+
+        /// @brief Largest radius that each segment count draws within tolerance.
+        float maxRadius[tableCount] = {};
+        grVec2 points[pointCount];
+
+        /// @brief Picks the fewest segments that keep a circle of the given radius smooth.
+        int segmentsFor(float radius) const noexcept {
+            for (int table = 0; table != tableCount - 1; ++table) {
+                if (radius <= maxRadius[table])
+                    return (table + 1) * segmentStep;
+            }
+            return maxSegments;
+        }
+
+        /// @brief Unit-circle points for a segment count chosen by segmentsFor.
+        grVec2 const* circle(int segments) const noexcept {
+            int const table = segments / segmentStep - 1;
+            return points + segmentStep * table * (table + 1) / 2;
+        }
+    };
+
+    GOOBER_API void grBuildCircleTable(grCircleTable& table);
+
     // ------------------------------------------------------
     //  * grDrawList drawing helper *
     // ------------------------------------------------------
 
+    /// @brief Stacking layers of a draw list; later layers draw on top of earlier ones.
+    /// Lists writing to caller blocks or flushing chunks merge their layers as each block or
+    /// chunk is handed off, so layers only stack within it: geometry handed off later draws
+    /// over an earlier overlay.
+    enum class grDrawLayer : std::uint8_t { Background, Content, Overlay };
+
     struct grDrawList {
         using Index = std::uint16_t;
         using Offset = std::uint32_t;
+        using Slot = std::uint8_t;
+
+        static constexpr int maxTextureSlots = 8;
 
         struct Vertex {
             grVec2 pos;
@@ -24,36 +68,264 @@ inline namespace goober {
             grColor rgba;
         };
 
+        /// @brief Vertex recorded in uniform color mode, where the color lives on the command.
+        struct CompactVertex {
+            grVec2 pos;
+            grVec2 uv;
+        };
+
+        struct Command;
+
+        /// @brief Runs custom rendering, such as a 3D viewport, at its place in the commands.
+        /// @param userData Value given to drawCallback.
+        /// @param draw Draw list being rendered.
+        /// @param cmd Command holding the callback.
+        using CommandCallback =
+            void (*)(void* userData, grDrawList const& draw, Command const& cmd);
+
         struct Command {
             Offset indexStart = 0;
             Offset indexCount = 0;
             grTextureId textureId = 0;
+            /// @brief Color of every vertex in uniform color mode; white otherwise.
+            grColor color = grColors::white;
+            /// @brief Textures bound for the command in texture slot mode, held in
+            /// slotTextures from textureStart and selected per vertex by vertexSlots;
+            /// textureId repeats the first of them.
+            Offset textureStart = 0;
+            Slot textureCount = 0;
+            /// @brief When set, the backend calls this instead of drawing indices, which are
+            /// empty; callbackBounds is the screen area the callback may draw to.
+            CommandCallback callback = nullptr;
+            void* callbackUserData = nullptr;
+            grRect callbackBounds;
+            /// @brief Vertices recorded before the callback; translate and scale move its
+            /// bounds along with the vertices from there on.
+            Offset callbackVertex = 0;
+        };
+
+        /// @brief Caller-owned memory, such as a mapped GPU buffer, that receives geometry.
+        /// Uniform color mode fills compactVertices instead of vertices.
+        struct Block {
+            Vertex* vertices = nullptr;
+            Index* indices = nullptr;
+            Offset vertexCapacity = 0;
+            Offset indexCapacity = 0;
+            CompactVertex* compactVertices = nullptr;
+        };
+
+        /// @brief Supplies the next output block when the current one is exhausted.
+        /// @param userData Value of blockUserData.
+        /// @param draw Draw list holding the completed contents of the previous block, which
+        /// the callback must consume; empty on the first request after a reset.
+        /// @return Next block; an empty block makes the draw list use its own memory, growing
+        /// as needed without further requests, until it is reset.
+        using BlockCallback = Block (*)(void* userData, grDrawList const& draw);
+
+        /// @brief Receives a completed chunk of geometry in streaming mode.
+        /// @param userData Value of flushUserData.
+        /// @param draw Draw list holding complete commands; it is cleared and reused after the
+        /// callback returns, so the geometry must be copied or uploaded before then.
+        using FlushCallback = void (*)(void* userData, grDrawList const& draw);
+
+        /// @brief Indices and commands recorded for one layer.
+        struct LayerStream {
+            grArray<Index> indices;
+            grArray<Command> commands;
         };
 
+        /// @brief Indices and commands of the current layer; other layers are parked in
+        /// layerStreams until finalize merges them.
         grArray<Index> indices;
         grArray<Vertex> vertices;
         grArray<Command> commands;
 
+        /// @brief Vertices recorded in uniform color mode; indices refer to these instead.
+        grArray<CompactVertex> compactVertices;
+
+        /// @brief Texture slot of each vertex in texture slot mode, parallel to the vertices.
+        /// Always owned by the draw list, even when the vertices live in a caller's block.
+        grArray<Slot> vertexSlots;
+
+        /// @brief Textures bound by each command in texture slot mode, kept out of the
+        /// commands so that lists without slots keep small commands.
+        grArray<grTextureId> slotTextures;
+
+        static constexpr int layerCount = 3;
+
+        /// @brief Layer that receives new geometry; its own slot in layerStreams is empty.
+        grDrawLayer layer = grDrawLayer::Content;
+        LayerStream layerStreams[layerCount];
+
+        /// @brief Width of the anti-aliased fringe around shapes and lines; 0 disables it.
+        float feather = 1.f;
+
+        /// @brief Records colors on commands and writes CompactVertex, splitting commands
+        /// when the color changes. Shapes and lines lose their fringe, which needs per-vertex
+        /// alpha. Must only change while the list is empty.
+        bool uniformColor = false;
+
+        /// @brief Number of textures one command may bind, up to maxTextureSlots, so that
+        /// changing between them does not split commands; 0 disables texture slot mode. Must
+        /// only change while the list is empty.
+        Slot textureSlots = 0;
+
+        /// @brief Tessellation tables; standalone draw lists fall back to a shared table.
+        grCircleTable const* circleTable = nullptr;
+
+        /// @brief When set, geometry is written directly into caller-provided blocks.
+        BlockCallback blockCallback = nullptr;
+        void* blockUserData = nullptr;
+        /// @brief Set when blockCallback returned an empty block; cleared by reset.
+        bool blockDeclined = false;
+
+        /// @brief When set, geometry is flushed each time a chunk fills; a chunk size of 0, or
+        /// one beyond the full range of Index, uses that full range.
+        FlushCallback flushCallback = nullptr;
+        void* flushUserData = nullptr;
+        Offset chunkVertices = 0;
+        Offset chunkIndices = 0;
+
         GOOBER_API void drawRect(grRect rect, grColor color);
         GOOBER_API void drawRect(
             grTextureId textureId,
             grRect rect,
             grRect texCoord,
             grColor color);
+        GOOBER_API void drawRects(grRect const* rects, grColor const* colors, Offset count);
+        GOOBER_API void drawImages(
+            grTextureId textureId,
+            grRect const* rects,
+            grRect const* texCoords,
+            grColor const* colors,
+            Offset count);
+        GOOBER_API void drawLine(grVec2 from, grVec2 to, grColor color, float thickness = 1.f);
+        GOOBER_API void drawPolyline(
+            grVec2 const* points,
+            Offset count,
+            grColor color,
+            float thickness = 1.f,
+            bool closed = false);
+        GOOBER_API void drawCircle(grVec2 center, float radius, grColor color);
+        GOOBER_API void drawRoundRect(grRect rect, float radius, grColor color);
         GOOBER_API void drawText(
             grFont const* font,
             grTextureId textureId,
             grVec2 ul,
             grColor,
             grStringView text);
+        /// @brief Draws text laid out by grFontLayoutText without looking up its glyphs again.
+        GOOBER_API void drawTextRun(
+            grTextureId textureId,
+            grVec2 ul,
+            grColor color,
+            grTextRun const& run);
+        /// @brief Draws text from the text cache by copying its quads into place.
+        GOOBER_API void drawCachedText(
+            grTextureId textureId,
+            grVec2 ul,
+            grColor color,
+            grCachedText const& text);
+
+        /// @brief Textures bound by a command in texture slot mode; textureCount long.
+        grTextureId const* textures(Command const& cmd) const noexcept {
+            return slotTextures.data() + cmd.textureStart;
+        }
+
+        /// @brief Records a callback command between the geometry drawn before and after it.
+        /// @param bounds Screen area the callback draws to; it is damaged every frame.
+        GOOBER_API void drawCallback(CommandCallback callback, void* userData, grRect bounds);
+
+        /// @brief Moves already-recorded vertices, and the bounds of callbacks recorded
+        /// after them, without rebuilding them.
+        /// @param offset Amount added to each vertex position.
+        /// @param fromVertex First vertex to move.
+        GOOBER_API void translate(grVec2 offset, Offset fromVertex = 0);
+
+        /// @brief Scales already-recorded vertices, and the bounds of callbacks recorded
+        /// after them, without rebuilding them.
+        /// @param factor Per-axis scale factor.
+        /// @param origin Point that remains fixed.
+        /// @param fromVertex First vertex to scale.
+        GOOBER_API void scale(grVec2 factor, grVec2 origin, Offset fromVertex = 0);
+
+        /// @brief Selects the layer that receives subsequent geometry.
+        GOOBER_API void setLayer(grDrawLayer target) noexcept;
+
+        /// @brief Merges every layer into indices and commands in stacking order and selects
+        /// the content layer; called by grEndFrame.
+        GOOBER_API void finalize();
+
+        GOOBER_API void flush();
+
+        /// @brief Replaces recorded geometry with a copy of another finalized draw list's.
+        GOOBER_API void copyGeometry(grDrawList const& source);
+
+        /// @brief Exchanges recorded geometry with another draw list, leaving settings in place.
+        /// Both lists must be finalized.
+        void swapGeometry(grDrawList& other) noexcept {
+            indices.swap(other.indices);
+            vertices.swap(other.vertices);
+            compactVertices.swap(other.compactVertices);
+            vertexSlots.swap(other.vertexSlots);
+            slotTextures.swap(other.slotTextures);
+            commands.swap(other.commands);
+        }
 
         void reset() noexcept {
-            indices.clear();
-            vertices.clear();
+            setLayer(grDrawLayer::Content);
+            for (LayerStream& stream : layerStreams) {
+                stream.indices.clear();
+                stream.commands.clear();
+            }
+
+            indices.detach();
+            vertices.detach();
+            compactVertices.detach();
+            vertexSlots.clear();
+            slotTextures.clear();
             commands.clear();
+            blockDeclined = false;
         }
     };
 
+    // ------------------------------------------------------
+    //  * grDrawData frame output *
+    // ------------------------------------------------------
+
+    /// @brief Immutable snapshot of the geometry produced by one frame.
+    struct grDrawData {
+        static constexpr std::size_t maxDamageRects = 8;
+
+        /// @brief One draw list per portal, in creation order.
+        grArray<grDrawList> lists;
+        std::uint64_t frame = 0;
+
+        /// @brief Whole-pixel screen areas that differ from the frame grGetDrawData returned
+        /// before this one, at most maxDamageRects; empty when nothing changed since. Frames
+        /// published but never taken by grGetDrawData have their damage carried over.
+        grArray<grRect> damage;
+        /// @brief False when a portal handed its geometry to a block or flush callback,
+        /// leaving nothing to compare; the whole screen must be treated as damaged.
+        bool damageKnown = true;
+    };
+
+    // ------------------------------------------------------
+    //  * damage tracking *
+    // ------------------------------------------------------
+
+    /// @brief Appends the screen areas where two finalized draw lists draw differently.
+    /// Geometry inserted or removed in one place only damages that place, even though it
+    /// renumbers the vertices after it.
+    GOOBER_API void grAppendDamage(
+        grDrawList const& previous,
+        grDrawList const& current,
+        grArray<grRect>& damage);
+
+    /// @brief Rounds rects out to whole pixels, combines overlapping ones, and then combines
+    /// the pairs that add the least area until at most maxRects remain.
+    GOOBER_API void grMergeDamage(grArray<grRect>& damage, std::size_t maxRects);
+
 } // namespace goober
 
 #endif // defined(GOOBER_DRAW_HH_)
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "core.hh"
+#include "draw.hh"
 
 inline namespace goober {
     // ------------------------------------------------------
@@ -20,6 +21,22 @@ inline namespace goober {
         grRect texCoord;
     };
 
+    /// @brief Glyph quad relative to the pen, in 1/16ths of a pixel.
+    struct grGlyphExtent {
+        static constexpr float unit = 1.f / 16.f;
+
+        std::int16_t left = 0;
+        std::int16_t top = 0;
+        std::int16_t right = 0;
+        std::int16_t bottom = 0;
+
+        grRect rect() const noexcept {
+            return {{left * unit, top * unit}, {right * unit, bottom * unit}};
+        }
+    };
+
+    struct grFontPacker;
+
     struct grFontAtlas {
         unsigned char* data = nullptr;
         unsigned int width = 0;
@@ -27,6 +44,42 @@ inline namespace goober {
         unsigned int bpp = 0;
         grTextureId texture = 0;
         bool dirty = true;
+        /// @brief Areas of data changed since the texture was last bound, in pixels; the whole
+        /// atlas after it is rebuilt. grGetFontAtlasIfDirtyAlpha8 merges them down to at most
+        /// maxDirtyRects, so that backends can upload just those areas.
+        grArray<grRect> dirtyRects;
+        static constexpr std::size_t maxDirtyRects = 8;
+        /// @brief Baked atlases start at minSize and double in width or height until every
+        /// glyph fits; full dynamic atlases double the same way. Neither grows past maxSize.
+        static constexpr unsigned int minSize = 64;
+        unsigned int maxSize = 4096;
+        /// @brief Glyphs left out of the last rebuild or repack because they did not fit.
+        std::size_t droppedGlyphs = 0;
+        /// @brief Glyphs are rasterized the first time they are looked up rather than baked up
+        /// front; see grSetFontAtlasDynamic.
+        bool dynamic = false;
+        /// @brief A dynamic atlas ran out of room this frame; the next grBeginFrame grows it or,
+        /// at maxSize, evicts the glyphs that were not used in the frame.
+        bool full = false;
+        grFontPacker* packer = nullptr;
+
+        ~grFontAtlas();
+    };
+
+    /// @brief How much of the font atlas the glyphs cover.
+    struct grFontAtlasStats {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::size_t glyphCount = 0;
+        /// @brief Texels covered by glyph bitmaps, not counting the padding between them.
+        std::size_t usedTexels = 0;
+        std::size_t droppedGlyphs = 0;
+
+        /// @brief Fraction of the atlas covered by glyphs.
+        float occupancy() const noexcept {
+            std::size_t const texels = std::size_t{width} * height;
+            return texels != 0 ? static_cast<float>(usedTexels) / texels : 0.f;
+        }
     };
 
     struct grFontGlyphRange {
@@ -36,15 +89,84 @@ inline namespace goober {
     };
 
     struct grFont {
+        static constexpr int directGlyphCount = 256;
+
         grFontId fontId = 0;
         grString name;
+        /// @brief Complete glyph records, used by single-glyph queries.
         grArray<grGlyph> glyphs;
+        /// @brief Glyph data split by use and indexed like glyphs, so that measuring reads only
+        /// advances and drawing only extents and texCoords.
+        grArray<float> advances;
+        grArray<grGlyphExtent> extents;
+        grArray<grRect> texCoords;
+        /// @brief Ranges of codepoints mapped to consecutive glyphs, sorted by first codepoint.
         grArray<grFontGlyphRange> glyphRanges;
+        /// @brief Index + 1 of the glyph for each codepoint below directGlyphCount; 0 if none.
+        std::int32_t directGlyphs[directGlyphCount] = {};
+        /// @brief Advance shared by every glyph of a monospace font; 0 for proportional fonts.
+        float monospaceAdvance = 0.f;
+        /// @brief Every printable ASCII character has a glyph, so printable ASCII text has one
+        /// glyph per byte.
+        bool hasPrintableAscii = false;
+        /// @brief One past the frame each glyph was last looked up in; dynamic atlases only.
+        grArray<std::uint64_t> glyphUsed;
         grContext* context = nullptr;
         float fontSize = 12.f;
         float lineHeight = 12.f;
     };
 
+    /// @brief Size of a string measured in one font, remembered across frames.
+    struct grCachedText {
+        grFontId fontId = 0;
+        std::uint64_t hash = 0;
+        grString text;
+        grVec2 size;
+        std::uint64_t lastUsed = 0;
+        /// @brief Vertices of the glyph quads with the text's upper left at the origin; built
+        /// the first time the text is drawn.
+        grArray<grDrawList::CompactVertex> quads;
+        /// @brief Glyphs behind quads, stamped as used whenever the entry is; dynamic
+        /// atlases only.
+        grArray<std::uint32_t> glyphs;
+        bool quadsBuilt = false;
+    };
+
+    /// @brief Sizes and glyph quads of recently used strings, so that labels measured and
+    /// drawn every frame skip the glyph lookups. A string is only added once it is seen again
+    /// in a later frame, so text that changes every frame never enters the cache. Entries not
+    /// used for maxAge frames are dropped, and everything is dropped when fonts are created,
+    /// destroyed, or rebuilt.
+    struct grTextCache {
+        /// @brief A string seen but not yet cached.
+        struct Candidate {
+            std::uint64_t hash = 0;
+            /// @brief One past the frame the string was first seen in; 0 if unused.
+            std::uint64_t seen = 0;
+        };
+        static constexpr std::size_t candidateCount = 1024;
+
+        std::uint64_t maxAge = 60;
+        std::uint64_t sweptFrame = 0;
+        grArray<grCachedText> entries;
+        /// @brief Candidates by hash; strings whose hashes collide wait longer to be added.
+        Candidate candidates[candidateCount];
+        /// @brief Open-addressed table of entry index + 1, or 0 when empty; its size is a
+        /// power of two at least twice the number of entries.
+        grArray<std::uint32_t> slots;
+    };
+
+    /// @brief A line of text whose glyphs are resolved once, then used both to size the
+    /// widget holding it and to draw it. Valid until the fonts are rebuilt.
+    struct grTextRun {
+        grFont const* font = nullptr;
+        /// @brief Index of each glyph in the font's glyph arrays.
+        grArray<std::uint32_t> glyphs;
+        /// @brief Offset of each glyph from the start of the line.
+        grArray<float> pens;
+        grVec2 size;
+    };
+
     // ------------------------------------------------------
     //  * core public interfaces *
     // ------------------------------------------------------
@@ -54,11 +176,63 @@ inline namespace goober {
 
     GOOBER_API grFont const* grGetFont(grContext* context, grFontId fontId);
 
+    /// @brief Sorts the glyph ranges, rebuilds the direct lookup table and the split glyph
+    /// arrays, and detects monospace fonts after glyphs or glyphRanges change. Glyph extents
+    /// are rounded to the precision of grGlyphExtent.
+    GOOBER_API void grFontBuildGlyphLookup(grFont* font);
+
     GOOBER_API grGlyph const* grFontGetGlyph(grFont const* font, int codepoint);
+
+    /// @brief Decodes the UTF-8 sequence at it and advances past it. A malformed sequence
+    /// yields U+FFFD and consumes a single byte.
+    GOOBER_API int grDecodeUtf8(char const*& it, char const* end) noexcept;
+
+    /// @brief Decodes UTF-8 text and looks up glyphs until maxGlyphs are found or the text
+    /// ends, skipping codepoints that have no glyph. Runs of ASCII are looked up in blocks.
+    /// @param it Start of the text; advanced past the consumed bytes.
+    /// @param glyphs Receives the index of each glyph in the font's glyph arrays.
+    /// @return Number of glyphs written.
+    GOOBER_API std::size_t grFontGetGlyphs(
+        grFont const* font,
+        char const*& it,
+        char const* end,
+        std::uint32_t* glyphs,
+        std::size_t maxGlyphs);
     GOOBER_API grGlyph const* grFontGetGlyph(grContext* context, grFontId fontId, int codepoint);
 
+    /// @brief Resolves the glyphs of a single line of text into run, reusing its memory.
+    GOOBER_API void grFontLayoutText(grFont const* font, grStringView text, grTextRun& run);
+
+    /// @brief Measures a single line of text, reusing the size measured in an earlier frame
+    /// when there is one.
     GOOBER_API grVec2 grFontMeasureText(grContext* context, grFontId fontId, grStringView text);
 
+    /// @brief Finds the cached size and glyph quads of a single line of text for drawing with
+    /// drawCachedText. The entry is valid until the next use of the context's text cache.
+    /// @return Entry, or nullptr for text not seen in an earlier frame and in builder contexts,
+    /// which have no text cache.
+    GOOBER_API grCachedText const* grFontGetCachedText(
+        grContext* context,
+        grFontId fontId,
+        grStringView text);
+
+    /// @brief Switches between baking every glyph up front and rasterizing glyphs into the
+    /// atlas the first time they are looked up. Dynamic lookups modify the fonts, so text must
+    /// then only be measured and drawn on the context's own thread: switching to dynamic
+    /// fails with Unsupported while portal builders exist, and grCreatePortalBuilder fails
+    /// while the atlas is dynamic.
+    /// @param size Initial width and height of the dynamic atlas in pixels.
+    GOOBER_API grStatus grSetFontAtlasDynamic(
+        grContext* context,
+        bool dynamic,
+        unsigned int size = 512);
+
+    /// @brief Called by grBeginFrame; grows a full dynamic atlas, or evicts the glyphs it did
+    /// not use during the last frame, packing the rest again.
+    GOOBER_API void grFontAtlasBeginFrame(grContext* context);
+
+    GOOBER_API grFontAtlasStats grGetFontAtlasStats(grContext* context);
+
     GOOBER_API grFontAtlas const* grGetFontAtlasIfDirtyAlpha8(grContext* context);
     GOOBER_API void grFontAtlasBindTexture(grContext* context, grTextureId textureId);
 
@@ -0,0 +1,92 @@
+// goober - by Sean Middleditch
+// This is free and unencumbered software released into the public domain.
+// See LICENSE.md for more details.
+
+#if !defined(GOOBER_IMAGE_HH_)
+#define GOOBER_IMAGE_HH_
+#pragma once
+
+#include "core.hh"
+
+inline namespace goober {
+    // ------------------------------------------------------
+    //  * image atlas *
+    // ------------------------------------------------------
+
+    struct grImagePacker;
+
+    /// @brief One RGBA8 texture page shared by many registered images. The pixel at the origin
+    /// is reserved as solid white for untextured geometry drawn in the page's commands.
+    struct grImageAtlasPage {
+        unsigned char* pixels = nullptr;
+        unsigned int size = 0;
+        grTextureId texture = 0;
+        bool dirty = true;
+        grImagePacker* packer = nullptr;
+    };
+
+    /// @brief Registered image and, while resident, its place in a page.
+    struct grAtlasImage {
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        int page = -1;
+        grRect texCoord;
+        /// @brief One past the frame the image was last drawn in; 0 if never drawn.
+        std::uint64_t lastUsed = 0;
+    };
+
+    /// @brief Packs small application images into shared pages so that they can be drawn
+    /// without a texture change each. New images are added to the existing pages as they
+    /// arrive; when every page is full, the least recently drawn page is cleared and its
+    /// images are packed again the next time they are drawn.
+    struct grImageAtlas {
+        /// @brief Width and height of new pages in pixels.
+        unsigned int pageSize = 512;
+        unsigned int maxPages = 4;
+        grArray<grImageAtlasPage*> pages;
+        /// @brief Registered images, indexed by image id - 1.
+        grArray<grAtlasImage> images;
+
+        ~grImageAtlas();
+    };
+
+    /// @brief Where a registered image can be sampled from.
+    struct grImageRegion {
+        grTextureId texture = 0;
+        grRect texCoord;
+    };
+
+    // ------------------------------------------------------
+    //  * image atlas public interfaces *
+    // ------------------------------------------------------
+
+    /// @brief Registers an image, copying its pixels, and packs it if a page has room.
+    /// @param rgba Tightly packed RGBA8 pixels.
+    GOOBER_API grResult<grImageId> grAddImage(
+        grContext* context,
+        unsigned char const* rgba,
+        int width,
+        int height);
+
+    /// @brief Unregisters an image; its page space is reclaimed when the page is recycled.
+    GOOBER_API grStatus grRemoveImage(grContext* context, grImageId imageId);
+
+    /// @brief Finds the page and texture coordinates of an image for drawing this frame,
+    /// packing it again if it was evicted. Images drawn this frame are never evicted.
+    /// Builder contexts have no image atlas, so this fails with Unsupported for them. Fails
+    /// with Empty while the image's page has no texture bound by grImageAtlasBindTexture, and
+    /// requests another frame so that the image can be drawn once it has.
+    GOOBER_API grResult<grImageRegion> grResolveImage(grContext* context, grImageId imageId);
+
+    GOOBER_API grImageAtlasPage const* grGetImageAtlasPageIfDirty(
+        grContext* context,
+        unsigned int page);
+    GOOBER_API void grImageAtlasBindTexture(
+        grContext* context,
+        unsigned int page,
+        grTextureId textureId);
+
+} // namespace goober
+
+#endif // defined(GOOBER_IMAGE_HH_)
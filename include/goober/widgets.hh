@@ -22,6 +22,8 @@ inline namespace goober {
         grRect pos,
         grRect texCoord,
         grColor rgba);
+    /// @brief Draws an image registered with grAddImage from its atlas page.
+    GOOBER_API void grImage(grContext* context, grImageId imageId, grRect pos, grColor rgba);
     GOOBER_API void grText(grContext* context, grStringView text, grVec2 pos, grColor rgba);
 
 } // namespace goober
@@ -5,6 +5,7 @@
 #include "goober/core.hh"
 #include "goober/draw.hh"
 #include "goober/font.hh"
+#include "goober/image.hh"
 
 inline namespace goober {
 
@@ -14,6 +15,15 @@ inline namespace goober {
             return grStatus::BadAlloc;
 
         context->fontAtlas = new (grAlloc(sizeof(grFontAtlas))) grFontAtlas;
+        context->textCache =
+            new (grAlloc(sizeof(grTextCache))) grTextCache;
+        context->imageAtlas = new (grAlloc(sizeof(grImageAtlas))) grImageAtlas;
+
+        context->circleTable = new (grAlloc(sizeof(grCircleTable))) grCircleTable;
+        grBuildCircleTable(*context->circleTable);
+
+        for (grDrawData*& data : context->drawData)
+            data = new (grAlloc(sizeof(grDrawData))) grDrawData;
 
         return context;
     }
@@ -21,36 +31,79 @@ inline namespace goober {
     grStatus grDestroyContext(grContext* context) {
         if (context == nullptr)
             return grStatus::NullArgument;
+        if (context->parent != nullptr)
+            return grStatus::Unsupported;
 
         context->fontAtlas->~grFontAtlas();
         grFree(context->fontAtlas);
 
+        context->textCache->~grTextCache();
+        grFree(context->textCache);
+
+        context->imageAtlas->~grImageAtlas();
+        grFree(context->imageAtlas);
+
+        context->circleTable->~grCircleTable();
+        grFree(context->circleTable);
+
+        for (grDrawData* data : context->drawData) {
+            data->~grDrawData();
+            grFree(data);
+        }
+
+        for (grPortalBuilder* builder : context->builders) {
+            builder->~grPortalBuilder();
+            grFree(builder);
+        }
+
         context->~grContext();
         grFree(context);
 
         return grStatus::Ok;
     }
 
-    grResult<grId> grBeginPortal(grContext* context, grStringView name) {
-        if (context == nullptr)
-            return grStatus::NullArgument;
-
+    static grPortal* grFindOrCreatePortal(grContext* context, grStringView name) {
         grId id = grHashFnv1a(name);
 
-        grPortal* port = nullptr;
-
         for (grPortal* sportal : context->portals) {
-            if (sportal->id == id) {
-                port = sportal;
-                break;
-            }
+            if (sportal->id == id)
+                return sportal;
         }
 
-        if (port == nullptr) {
-            port = context->portals.push_back(new (grAlloc(sizeof(grPortal))) grPortal);
-            port->name = grString(name);
-            port->id = id;
-            port->draw.reset(new (grAlloc(sizeof(grDrawList))) grDrawList());
+        grPortal* port = context->portals.push_back(new (grAlloc(sizeof(grPortal))) grPortal);
+        port->name = grString(name);
+        port->id = id;
+        port->draw.reset(new (grAlloc(sizeof(grDrawList))) grDrawList());
+        port->draw->circleTable = context->circleTable;
+        return port;
+    }
+
+    // true when a builder is filling the portal or it is open on the context's portal stack,
+    // so that a second writer would race with it
+    static bool grIsPortalInUse(grContext const* context, grPortal const* port) noexcept {
+        for (grPortalBuilder const* builder : context->builders) {
+            if (builder->portal == port)
+                return true;
+        }
+        for (grPortal const* open : context->portalStack) {
+            if (open == port)
+                return true;
+        }
+        return false;
+    }
+
+    grResult<grId> grBeginPortal(grContext* context, grStringView name) {
+        if (context == nullptr)
+            return grStatus::NullArgument;
+        if (context->parent != nullptr)
+            return grStatus::Unsupported;
+
+        grPortal* port = grFindOrCreatePortal(context, name);
+        grId const id = port->id;
+
+        for (grPortalBuilder const* builder : context->builders) {
+            if (builder->portal == port)
+                return grStatus::Unsupported;
         }
 
         context->portalStack.push_back(port);
@@ -81,6 +134,67 @@ inline namespace goober {
         return context->currentPortal;
     }
 
+    grResult<grPortalBuilder*> grCreatePortalBuilder(grContext* context, grStringView name) {
+        if (context == nullptr)
+            return grStatus::NullArgument;
+        // dynamic glyph lookups modify the shared fonts, so they cannot run on other threads
+        if (context->parent != nullptr || context->fontAtlas->dynamic)
+            return grStatus::Unsupported;
+
+        grPortal* port = grFindOrCreatePortal(context, name);
+        if (grIsPortalInUse(context, port))
+            return grStatus::Unsupported;
+
+        grPortalBuilder* builder = new (grAlloc(sizeof(grPortalBuilder))) grPortalBuilder;
+        if (builder == nullptr)
+            return grStatus::BadAlloc;
+        context->builders.push_back(builder);
+
+        builder->portal = port;
+        builder->activeIdStart = context->activeId;
+
+        grContext& view = builder->context;
+        view.parent = context;
+        view.mousePosLast = context->mousePosLast;
+        view.mousePos = context->mousePos;
+        view.mousePosDelta = context->mousePosDelta;
+        view.modifiers = context->modifiers;
+        view.mouseButtonsLast = context->mouseButtonsLast;
+        view.mouseButtons = context->mouseButtons;
+        view.deltaTime = context->deltaTime;
+        view.activeId = context->activeId;
+        view.fontAtlas = context->fontAtlas;
+        view.frame = context->frame;
+
+        view.fonts.reserve(context->fonts.size());
+        for (grFont* font : context->fonts)
+            view.fonts.push_back(font);
+
+        view.portalStack.push_back(port);
+        view.currentPortal = port;
+        view.currentDrawList = port->draw.get();
+
+        return builder;
+    }
+
+    static void grMergePortalBuilders(grContext* context) {
+        for (grPortalBuilder* builder : context->builders) {
+            grContext const& view = builder->context;
+
+            if (view.activeId != builder->activeIdStart)
+                context->activeId = view.activeId;
+            if (view.activeIdNext != grId{})
+                context->activeIdNext = view.activeIdNext;
+            if (view.animationDelay >= 0.f)
+                grRequestAnimation(context, view.animationDelay);
+
+            builder->~grPortalBuilder();
+            grFree(builder);
+        }
+
+        context->builders.clear();
+    }
+
     grDrawList* grCurrentDrawList(grContext* context) {
         if (context == nullptr)
             return nullptr;
@@ -90,6 +204,8 @@ inline namespace goober {
     grStatus grBeginFrame(grContext* context, float deltaTime) {
         if (context == nullptr)
             return grStatus::NullArgument;
+        if (context->parent != nullptr)
+            return grStatus::Unsupported;
 
         for (grPortal* port : context->portals) {
             port->idStack.clear();
@@ -99,14 +215,77 @@ inline namespace goober {
         context->activeId = context->activeIdNext;
         context->activeIdNext = {};
 
+        grFontAtlasBeginFrame(context);
+
         context->mousePosDelta = context->mousePos - context->mousePosLast;
         context->deltaTime = deltaTime;
+        context->animationDelay = -1.f;
         return grStatus::Ok;
     }
 
-    grStatus grEndFrame(grContext* context) {
+    grStatus grEndFrame(grContext* context, grFrameStatus* status) {
         if (context == nullptr)
             return grStatus::NullArgument;
+        if (context->parent != nullptr)
+            return grStatus::Unsupported;
+
+        grMergePortalBuilders(context);
+
+        grDrawData& building = *context->drawData[context->drawDataBuilding];
+        building.lists.resize(context->portals.size());
+        building.frame = ++context->frame;
+
+        building.damage.clear();
+        building.damageKnown = true;
+
+        // the last published snapshot is only read by the consumer, so it can be compared
+        // against without keeping a copy of its geometry
+        grDrawData const& published = *context->drawData[context->drawDataPublished];
+        grDrawList const unpublished;
+
+        for (std::size_t index = 0; index != context->portals.size(); ++index) {
+            grPortal& port = *context->portals[index];
+            grDrawList& draw = *port.draw;
+            draw.finalize();
+            draw.flush();
+
+            // geometry handed to a block or flush callback is gone, so nothing is compared
+            if (draw.blockCallback != nullptr || draw.flushCallback != nullptr)
+                building.damageKnown = false;
+            else if (building.damageKnown) {
+                grDrawList const& previous =
+                    index < published.lists.size() ? published.lists[index] : unpublished;
+                grAppendDamage(previous, draw, building.damage);
+            }
+
+            draw.swapGeometry(building.lists[index]);
+            draw.reset();
+        }
+
+        grMergeDamage(building.damage, grDrawData::maxDamageRects);
+
+        if (status != nullptr) {
+            status->changed = !building.damageKnown || !building.damage.empty();
+            status->animating = context->animationDelay >= 0.f;
+            status->nextWakeup = context->animationDelay;
+        }
+
+        // a snapshot the consumer never took is replaced by this one, so its changes are
+        // carried over; should the consumer take it meanwhile, the damage is merely larger
+        bool const skipped = (context->drawDataReady.load(std::memory_order_acquire) &
+                              grContext::drawDataFresh) != 0;
+        if (skipped) {
+            building.damageKnown = building.damageKnown && published.damageKnown;
+            for (grRect const& rect : published.damage)
+                building.damage.push_back(rect);
+            grMergeDamage(building.damage, grDrawData::maxDamageRects);
+        }
+
+        unsigned const previous = context->drawDataReady.exchange(
+            context->drawDataBuilding | grContext::drawDataFresh,
+            std::memory_order_acq_rel);
+        context->drawDataPublished = context->drawDataBuilding;
+        context->drawDataBuilding = previous & ~grContext::drawDataFresh;
 
         context->mousePosLast = context->mousePos;
         context->mouseButtonsLast = context->mouseButtons;
@@ -116,6 +295,33 @@ inline namespace goober {
         return grStatus::Ok;
     }
 
+    grStatus grRequestAnimation(grContext* context, float delay) {
+        if (context == nullptr)
+            return grStatus::NullArgument;
+
+        if (delay < 0.f)
+            delay = 0.f;
+        if (context->animationDelay < 0.f || delay < context->animationDelay)
+            context->animationDelay = delay;
+        return grStatus::Ok;
+    }
+
+    grDrawData const* grGetDrawData(grContext* context) {
+        if (context == nullptr)
+            return nullptr;
+
+        if ((context->drawDataReady.load(std::memory_order_relaxed) & grContext::drawDataFresh) !=
+            0) {
+            unsigned const previous = context->drawDataReady.exchange(
+                context->drawDataConsuming,
+                std::memory_order_acq_rel);
+            context->drawDataConsuming = previous & ~grContext::drawDataFresh;
+        }
+
+        grDrawData const* data = context->drawData[context->drawDataConsuming];
+        return data->frame != 0 ? data : nullptr;
+    }
+
     grId grGetId(grContext const* context, uint64_t hash) noexcept {
         if (context == nullptr)
             return static_cast<grId>(hash);
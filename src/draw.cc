@@ -2,72 +2,961 @@
 // This is free and unencumbered software released into the public domain.
 // See LICENSE.md for more details.
 
+#include "simd.hh"
 #include "goober/draw.hh"
 #include "goober/font.hh"
 
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
 inline namespace goober {
 
+    static constexpr unsigned noTextureSlot = ~0u;
+
+    static unsigned textureSlotCount(grDrawList const& draw) noexcept {
+        return draw.textureSlots < grDrawList::maxTextureSlots ? draw.textureSlots
+                                                               : grDrawList::maxTextureSlots;
+    }
+
+    // finds or adds the texture among the command's slots; untextured geometry
+    // samples the white pixel of any texture, so it shares slot 0
+    static unsigned findTextureSlot(
+        grDrawList& draw,
+        grDrawList::Command& cmd,
+        grTextureId textureId,
+        unsigned slots) {
+        if (textureId == 0)
+            return 0;
+
+        grArray<grTextureId>& textures = draw.slotTextures;
+        for (unsigned slot = 0; slot != cmd.textureCount; ++slot) {
+            if (textures[cmd.textureStart + slot] == textureId)
+                return slot;
+        }
+
+        if (cmd.textureCount == slots)
+            return noTextureSlot;
+
+        // a command grows its set at the end of the array; one whose set was followed by
+        // another layer's moves its set there first
+        std::size_t const end = std::size_t{cmd.textureStart} + cmd.textureCount;
+        if (end != textures.size()) {
+            auto const start = static_cast<grDrawList::Offset>(textures.size());
+            for (unsigned slot = 0; slot != cmd.textureCount; ++slot) {
+                grTextureId const moved = textures[cmd.textureStart + slot];
+                textures.push_back(moved);
+            }
+            cmd.textureStart = start;
+        }
+
+        if (cmd.textureCount == 0)
+            cmd.textureId = textureId;
+        textures.push_back(textureId);
+        return cmd.textureCount++;
+    }
+
+    // the color only splits commands in uniform color mode; slot receives the
+    // texture slot that new vertices must use in texture slot mode
     static grDrawList::Command& pushCommand(
-        grArray<grDrawList::Command>& commands,
-        grTextureId textureId) {
-        if (!commands.empty()) {
+        grDrawList& draw,
+        grTextureId textureId,
+        grColor color = grColors::white,
+        unsigned* slot = nullptr) {
+        grArray<grDrawList::Command>& commands = draw.commands;
+        if (!draw.uniformColor)
+            color = grColors::white;
+
+        unsigned const slots = textureSlotCount(draw);
+        unsigned found = 0;
+
+        if (!commands.empty() && commands.back().callback == nullptr) {
             grDrawList::Command& cmd = commands.back();
-            if (cmd.indexCount == 0 || cmd.textureId == 0) {
+            if (cmd.indexCount == 0) {
                 cmd.textureId = textureId;
+                cmd.color = color;
+                if (std::size_t{cmd.textureStart} + cmd.textureCount == draw.slotTextures.size())
+                    draw.slotTextures.resize(cmd.textureStart);
+                cmd.textureStart = static_cast<grDrawList::Offset>(draw.slotTextures.size());
+                cmd.textureCount = 0;
+                if (slots != 0)
+                    found = findTextureSlot(draw, cmd, textureId, slots);
+                if (slot != nullptr)
+                    *slot = found;
                 return cmd;
             }
 
-            if (textureId == 0 || cmd.textureId == textureId)
-                return cmd;
+            if (cmd.color == color) {
+                if (slots != 0) {
+                    found = findTextureSlot(draw, cmd, textureId, slots);
+                    if (found != noTextureSlot) {
+                        if (slot != nullptr)
+                            *slot = found;
+                        return cmd;
+                    }
+                }
+                else if (cmd.textureId == 0) {
+                    cmd.textureId = textureId;
+                    return cmd;
+                }
+                else if (textureId == 0 || cmd.textureId == textureId)
+                    return cmd;
+            }
         }
 
         grDrawList::Command& cmd = commands.push_back({});
+        cmd.indexStart = static_cast<grDrawList::Offset>(draw.indices.size());
         cmd.textureId = textureId;
+        cmd.color = color;
+        cmd.textureStart = static_cast<grDrawList::Offset>(draw.slotTextures.size());
+        if (slots != 0)
+            findTextureSlot(draw, cmd, textureId, slots);
+        if (slot != nullptr)
+            *slot = 0;
         return cmd;
     }
 
-    void grDrawList::drawRect(grRect rect, grColor color) {
-        Offset const vertex = static_cast<Offset>(vertices.size());
-        Offset const index = static_cast<Offset>(indices.size());
+    static bool sameBindings(
+        grDrawList const& firstDraw,
+        grDrawList::Command const& first,
+        grDrawList const& secondDraw,
+        grDrawList::Command const& second) noexcept {
+        if (first.textureId != second.textureId || first.color != second.color ||
+            first.textureCount != second.textureCount)
+            return false;
+
+        if (first.callback != second.callback || first.callbackUserData != second.callbackUserData)
+            return false;
+        if (first.callback != nullptr &&
+            (first.callbackBounds.minimum != second.callbackBounds.minimum ||
+             first.callbackBounds.maximum != second.callbackBounds.maximum))
+            return false;
+
+        grTextureId const* const firstTextures = firstDraw.textures(first);
+        grTextureId const* const secondTextures = secondDraw.textures(second);
+        for (unsigned slot = 0; slot != first.textureCount; ++slot) {
+            if (firstTextures[slot] != secondTextures[slot])
+                return false;
+        }
+        return true;
+    }
+
+    template <typename VertexT>
+    static constexpr bool hasVertexColor = std::is_same_v<VertexT, grDrawList::Vertex>;
+
+    // the array that receives vertices of the given type
+    template <typename VertexT>
+    static grArray<VertexT>& vertexArray(grDrawList& draw) noexcept {
+        if constexpr (hasVertexColor<VertexT>)
+            return draw.vertices;
+        else
+            return draw.compactVertices;
+    }
+
+    // appends vertices along with their texture slots in texture slot mode
+    template <typename VertexT>
+    static VertexT* appendVertices(grDrawList& draw, grDrawList::Offset count, unsigned slot) {
+        if (textureSlotCount(draw) != 0) {
+            grDrawList::Slot* const slots = draw.vertexSlots.append_uninitialized(count);
+            std::memset(slots, static_cast<int>(slot), count);
+        }
+        return vertexArray<VertexT>(draw).append_uninitialized(count);
+    }
+
+    template <typename VertexT>
+    static grArray<VertexT> const& vertexArray(grDrawList const& draw) noexcept {
+        return vertexArray<VertexT>(const_cast<grDrawList&>(draw));
+    }
+
+    static void setVertex(grDrawList::Vertex& out, grVec2 pos, grColor color) noexcept {
+        out = {pos, {}, color};
+    }
+
+    static void setVertex(grDrawList::CompactVertex& out, grVec2 pos, grColor) noexcept {
+        out = {pos, {}};
+    }
+
+    static void requestBlock(grDrawList& draw) {
+        grDrawLayer const layer = draw.layer;
+        draw.finalize();
+
+        grDrawList::Block const block = draw.blockCallback(draw.blockUserData, draw);
+
+        draw.commands.clear();
+        draw.vertices.detach();
+        draw.compactVertices.detach();
+        draw.vertexSlots.clear();
+        draw.slotTextures.clear();
+        draw.indices.detach();
+
+        if (block.indices != nullptr) {
+            if (!draw.uniformColor && block.vertices != nullptr) {
+                draw.vertices.attach(block.vertices, block.vertexCapacity);
+                draw.indices.attach(block.indices, block.indexCapacity);
+            }
+            else if (draw.uniformColor && block.compactVertices != nullptr) {
+                draw.compactVertices.attach(block.compactVertices, block.vertexCapacity);
+                draw.indices.attach(block.indices, block.indexCapacity);
+            }
+        }
+        draw.blockDeclined = !draw.indices.borrowed();
+
+        draw.setLayer(layer);
+    }
+
+    static std::size_t recordedVertices(grDrawList const& draw) noexcept {
+        return draw.uniformColor ? draw.compactVertices.size() : draw.vertices.size();
+    }
+
+    // vertices that 16-bit indices can address
+    static constexpr std::size_t maxIndexedVertices = std::size_t{1} << 16;
+
+    // room in the caller's block, clamped to what indices can address; memory the list kept
+    // from a declined block is not a block
+    static std::size_t vertexCapacity(grDrawList const& draw) noexcept {
+        grArray<grDrawList::Vertex> const& vertices = draw.vertices;
+        grArray<grDrawList::CompactVertex> const& compact = draw.compactVertices;
+        if (!(draw.uniformColor ? compact.borrowed() : vertices.borrowed()))
+            return 0;
+        std::size_t const capacity = draw.uniformColor ? compact.capacity() : vertices.capacity();
+        return capacity < maxIndexedVertices ? capacity : maxIndexedVertices;
+    }
+
+    // indices recorded on every layer, all of which finalize merges into one stream
+    static std::size_t recordedIndices(grDrawList const& draw) noexcept {
+        std::size_t count = draw.indices.size();
+        for (grDrawList::LayerStream const& stream : draw.layerStreams)
+            count += stream.indices.size();
+        return count;
+    }
 
-        Command& cmd = pushCommand(commands, 0);
+    // room in the caller's block, which is held by the content layer's stream
+    static std::size_t blockIndexCapacity(grDrawList const& draw) noexcept {
+        if (draw.layer == grDrawLayer::Content)
+            return draw.indices.capacity();
+        return draw.layerStreams[static_cast<int>(grDrawLayer::Content)].indices.capacity();
+    }
+
+    static grDrawList::Offset itemsThatFit(
+        std::size_t used,
+        std::size_t limit,
+        grDrawList::Offset perItem,
+        grDrawList::Offset itemCount) {
+        if (perItem == 0)
+            return itemCount;
+        std::size_t const room = used < limit ? (limit - used) / perItem : 0;
+        return room < itemCount ? static_cast<grDrawList::Offset>(room) : itemCount;
+    }
 
-        vertices.push_back({rect.minimum, {}, color});
-        vertices.push_back({{rect.maximum.x, rect.minimum.y}, {}, color});
-        vertices.push_back({rect.maximum, {}, color});
-        vertices.push_back({{rect.minimum.x, rect.maximum.y}, {}, color});
+    // determines how many items of the given size can be appended before the
+    // current block or chunk is exhausted, handing the completed geometry off
+    // first if not even one item fits; always grants at least one item
+    static grDrawList::Offset reserveItems(
+        grDrawList& draw,
+        grDrawList::Offset itemVertices,
+        grDrawList::Offset itemIndices,
+        grDrawList::Offset itemCount) {
+        std::size_t maxVertices = 0;
+        std::size_t maxIndices = 0;
 
-        indices.push_back(vertex + 0);
-        indices.push_back(vertex + 1);
-        indices.push_back(vertex + 2);
-        indices.push_back(vertex + 2);
-        indices.push_back(vertex + 3);
-        indices.push_back(vertex + 0);
+        if (draw.blockCallback != nullptr) {
+            // once declined, the list grows its own memory like any other
+            if (draw.blockDeclined)
+                return itemCount;
+            maxVertices = vertexCapacity(draw);
+            maxIndices = blockIndexCapacity(draw);
+        }
+        else if (draw.flushCallback != nullptr) {
+            if (draw.uniformColor)
+                draw.compactVertices.reserve(draw.chunkVertices);
+            else
+                draw.vertices.reserve(draw.chunkVertices);
+            draw.indices.reserve(draw.chunkIndices);
+
+            maxVertices = draw.chunkVertices != 0 ? draw.chunkVertices : maxIndexedVertices;
+            if (maxVertices > maxIndexedVertices)
+                maxVertices = maxIndexedVertices;
+            maxIndices = draw.chunkIndices != 0 ? draw.chunkIndices : ~std::size_t{0};
+        }
+        else
+            return itemCount;
 
-        cmd.indexCount += 6;
+        auto const fitting = [&] {
+            grDrawList::Offset const fit =
+                itemsThatFit(recordedVertices(draw), maxVertices, itemVertices, itemCount);
+            return itemsThatFit(recordedIndices(draw), maxIndices, itemIndices, fit);
+        };
+
+        grDrawList::Offset fit = fitting();
+        if (fit != 0)
+            return fit;
+
+        if (draw.blockCallback != nullptr) {
+            requestBlock(draw);
+            if (draw.blockDeclined)
+                return itemCount;
+            maxVertices = vertexCapacity(draw);
+            maxIndices = blockIndexCapacity(draw);
+        }
+        else
+            draw.flush();
+
+        // an item larger than a whole block or chunk makes the arrays grow instead
+        fit = fitting();
+        return fit != 0 ? fit : 1;
+    }
+
+    static void reserveGeometry(
+        grDrawList& draw,
+        grDrawList::Offset vertexCount,
+        grDrawList::Offset indexCount) {
+        reserveItems(draw, vertexCount, indexCount, 1);
+    }
+
+    static_assert(sizeof(grRect) == 4 * sizeof(float), "grRect must be four packed floats");
+    static_assert(offsetof(grDrawList::Vertex, uv) == 2 * sizeof(float), "uv must follow pos");
+    static_assert(
+        sizeof(grDrawList::CompactVertex) == 4 * sizeof(float),
+        "CompactVertex must be pos and uv only");
+
+    // writes the four corners of an offset quad
+    template <typename VertexT>
+    static void writeQuad(
+        VertexT* out,
+        grRect const& rect,
+        grVec2 offset,
+        grRect const& texCoord,
+        grColor color) noexcept {
+#if defined(GOOBER_SIMD_SSE2)
+        __m128 const pos = _mm_add_ps(
+            _mm_loadu_ps(&rect.minimum.x),
+            _mm_setr_ps(offset.x, offset.y, offset.x, offset.y));
+        __m128 const uv = _mm_loadu_ps(&texCoord.minimum.x);
+
+        // each vertex stores pos and uv as four consecutive floats
+        _mm_storeu_ps(&out[0].pos.x, _mm_movelh_ps(pos, uv));
+        _mm_storeu_ps(&out[1].pos.x, _mm_shuffle_ps(pos, uv, _MM_SHUFFLE(1, 2, 1, 2)));
+        _mm_storeu_ps(&out[2].pos.x, _mm_movehl_ps(uv, pos));
+        _mm_storeu_ps(&out[3].pos.x, _mm_shuffle_ps(pos, uv, _MM_SHUFFLE(3, 0, 3, 0)));
+#elif defined(GOOBER_SIMD_NEON)
+        float32x4_t const pos = vaddq_f32(
+            vld1q_f32(&rect.minimum.x),
+            vcombine_f32(vld1_f32(&offset.x), vld1_f32(&offset.x)));
+        float32x4_t const uv = vld1q_f32(&texCoord.minimum.x);
+
+        float32x2_t const posMin = vget_low_f32(pos);
+        float32x2_t const posMax = vget_high_f32(pos);
+        float32x2_t const uvMin = vget_low_f32(uv);
+        float32x2_t const uvMax = vget_high_f32(uv);
+
+        // selects x from the first operand and y from the second
+        uint32x2_t const selectX = vcreate_u32(0x00000000FFFFFFFFull);
+
+        vst1q_f32(&out[0].pos.x, vcombine_f32(posMin, uvMin));
+        vst1q_f32(
+            &out[1].pos.x,
+            vcombine_f32(vbsl_f32(selectX, posMax, posMin), vbsl_f32(selectX, uvMax, uvMin)));
+        vst1q_f32(&out[2].pos.x, vcombine_f32(posMax, uvMax));
+        vst1q_f32(
+            &out[3].pos.x,
+            vcombine_f32(vbsl_f32(selectX, posMin, posMax), vbsl_f32(selectX, uvMin, uvMax)));
+#else
+        grVec2 const minimum = rect.minimum + offset;
+        grVec2 const maximum = rect.maximum + offset;
+
+        out[0].pos = minimum;
+        out[0].uv = texCoord.minimum;
+        out[1].pos = {maximum.x, minimum.y};
+        out[1].uv = {texCoord.maximum.x, texCoord.minimum.y};
+        out[2].pos = maximum;
+        out[2].uv = texCoord.maximum;
+        out[3].pos = {minimum.x, maximum.y};
+        out[3].uv = {texCoord.minimum.x, texCoord.maximum.y};
+#endif
+        if constexpr (hasVertexColor<VertexT>) {
+            out[0].rgba = color;
+            out[1].rgba = color;
+            out[2].rgba = color;
+            out[3].rgba = color;
+        }
+    }
+
+    static void writeQuadIndices(
+        grDrawList::Index* out,
+        grDrawList::Offset vertex,
+        grDrawList::Offset quadCount) noexcept {
+        for (grDrawList::Offset quad = 0; quad != quadCount; ++quad, vertex += 4, out += 6) {
+            out[0] = static_cast<grDrawList::Index>(vertex + 0);
+            out[1] = static_cast<grDrawList::Index>(vertex + 1);
+            out[2] = static_cast<grDrawList::Index>(vertex + 2);
+            out[3] = static_cast<grDrawList::Index>(vertex + 2);
+            out[4] = static_cast<grDrawList::Index>(vertex + 3);
+            out[5] = static_cast<grDrawList::Index>(vertex + 0);
+        }
+    }
+
+    // appends indices for quads to a single command; the caller must have
+    // reserved room and must write every returned vertex
+    template <typename VertexT>
+    static VertexT* appendQuads(
+        grDrawList& draw,
+        grTextureId textureId,
+        grColor color,
+        grDrawList::Offset quadCount) {
+        unsigned slot = 0;
+        grDrawList::Command& cmd = pushCommand(draw, textureId, color, &slot);
+        grDrawList::Offset const vertex =
+            static_cast<grDrawList::Offset>(vertexArray<VertexT>(draw).size());
+
+        writeQuadIndices(draw.indices.append_uninitialized(quadCount * 6), vertex, quadCount);
+        cmd.indexCount += quadCount * 6;
+
+        return appendVertices<VertexT>(draw, quadCount * 4, slot);
+    }
+
+    // writes quads in as few commands as the output mode allows; in uniform color
+    // mode each run of equal colors shares a command
+    template <typename VertexT>
+    static void emitQuads(
+        grDrawList& draw,
+        grTextureId textureId,
+        grRect const* rects,
+        grRect const* texCoords,
+        grColor const* colors,
+        grDrawList::Offset count) {
+        using Offset = grDrawList::Offset;
+
+        for (Offset written = 0; written != count;) {
+            Offset run = count - written;
+            if constexpr (!hasVertexColor<VertexT>) {
+                run = 1;
+                while (written + run != count && colors[written + run] == colors[written])
+                    ++run;
+            }
+
+            Offset const quads = reserveItems(draw, 4, 6, run);
+            VertexT* const out = appendQuads<VertexT>(draw, textureId, colors[written], quads);
+
+            for (Offset quad = 0; quad != quads; ++quad) {
+                Offset const index = written + quad;
+                grRect const texCoord = texCoords != nullptr ? texCoords[index] : grRect{};
+                writeQuad(out + quad * 4, rects[index], {}, texCoord, colors[index]);
+            }
+            written += quads;
+        }
+    }
+
+    // replaces each value with the sum of the values before it; returns the total
+    static float exclusivePrefixSum(float* values, grDrawList::Offset count) noexcept {
+        grDrawList::Offset index = 0;
+        float total = 0.f;
+
+#if defined(GOOBER_SIMD_SSE2)
+        __m128 carry = _mm_setzero_ps();
+        for (; index + 4 <= count; index += 4) {
+            __m128 sum = _mm_loadu_ps(values + index);
+            sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 4)));
+            sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 8)));
+
+            __m128 const before = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 4));
+            _mm_storeu_ps(values + index, _mm_add_ps(before, carry));
+            carry = _mm_add_ps(carry, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+        total = _mm_cvtss_f32(carry);
+#elif defined(GOOBER_SIMD_NEON)
+        float32x4_t const zero = vdupq_n_f32(0.f);
+        float32x4_t carry = zero;
+        for (; index + 4 <= count; index += 4) {
+            float32x4_t sum = vld1q_f32(values + index);
+            sum = vaddq_f32(sum, vextq_f32(zero, sum, 3));
+            sum = vaddq_f32(sum, vextq_f32(zero, sum, 2));
+
+            vst1q_f32(values + index, vaddq_f32(vextq_f32(zero, sum, 3), carry));
+            carry = vaddq_f32(carry, vdupq_n_f32(vgetq_lane_f32(sum, 3)));
+        }
+        total = vgetq_lane_f32(carry, 0);
+#endif
+
+        for (; index != count; ++index) {
+            float const value = values[index];
+            values[index] = total;
+            total += value;
+        }
+        return total;
+    }
+
+    // applies pos * multiply + add to each vertex, leaving uv and color untouched
+    static void transformPositions(
+        grDrawList::Vertex* vertices,
+        std::size_t count,
+        grVec2 multiply,
+        grVec2 add) noexcept {
+        std::size_t index = 0;
+
+#if defined(GOOBER_SIMD_SSE2) || defined(GOOBER_SIMD_NEON)
+        float* floats = &vertices->pos.x;
+
+        // four vertices span five registers; pos lanes shift by one each register
+        static constexpr std::uint32_t on = ~std::uint32_t{0};
+        alignas(16) static constexpr std::uint32_t masks[5][4] = {
+            {on, on, 0, 0},
+            {0, on, on, 0},
+            {0, 0, on, on},
+            {0, 0, 0, on},
+            {on, 0, 0, 0},
+        };
+        float const pattern[2][6] = {
+            {multiply.x, multiply.y, multiply.x, multiply.y, multiply.x, multiply.y},
+            {add.x, add.y, add.x, add.y, add.x, add.y},
+        };
+        // where to load each register's factors from so x and y line up with its pos lanes
+        static constexpr int patternStart[5] = {0, 1, 0, 1, 1};
+#endif
+
+#if defined(GOOBER_SIMD_SSE2)
+        __m128 mul[5];
+        __m128 sum[5];
+        __m128 mask[5];
+        for (int reg = 0; reg != 5; ++reg) {
+            mul[reg] = _mm_loadu_ps(pattern[0] + patternStart[reg]);
+            sum[reg] = _mm_loadu_ps(pattern[1] + patternStart[reg]);
+            mask[reg] = _mm_load_ps(reinterpret_cast<float const*>(masks[reg]));
+        }
+
+        for (; index + 4 <= count; index += 4, floats += 20) {
+            for (int reg = 0; reg != 5; ++reg) {
+                __m128 const value = _mm_loadu_ps(floats + reg * 4);
+                __m128 const moved = _mm_add_ps(_mm_mul_ps(value, mul[reg]), sum[reg]);
+                _mm_storeu_ps(
+                    floats + reg * 4,
+                    _mm_or_ps(_mm_and_ps(mask[reg], moved), _mm_andnot_ps(mask[reg], value)));
+            }
+        }
+#elif defined(GOOBER_SIMD_NEON)
+        float32x4_t mul[5];
+        float32x4_t sum[5];
+        uint32x4_t mask[5];
+        for (int reg = 0; reg != 5; ++reg) {
+            mul[reg] = vld1q_f32(pattern[0] + patternStart[reg]);
+            sum[reg] = vld1q_f32(pattern[1] + patternStart[reg]);
+            mask[reg] = vld1q_u32(masks[reg]);
+        }
+
+        for (; index + 4 <= count; index += 4, floats += 20) {
+            for (int reg = 0; reg != 5; ++reg) {
+                float32x4_t const value = vld1q_f32(floats + reg * 4);
+                float32x4_t const moved = vmlaq_f32(sum[reg], value, mul[reg]);
+                vst1q_f32(floats + reg * 4, vbslq_f32(mask[reg], moved, value));
+            }
+        }
+#endif
+
+        for (; index != count; ++index) {
+            grDrawList::Vertex& vertex = vertices[index];
+            vertex.pos = {vertex.pos.x * multiply.x + add.x, vertex.pos.y * multiply.y + add.y};
+        }
+    }
+
+    // compact vertices hold exactly pos and uv, so uv passes through as * 1 + 0
+    static void transformPositions(
+        grDrawList::CompactVertex* vertices,
+        std::size_t count,
+        grVec2 multiply,
+        grVec2 add) noexcept {
+        std::size_t index = 0;
+
+#if defined(GOOBER_SIMD_SSE2)
+        __m128 const mul = _mm_setr_ps(multiply.x, multiply.y, 1.f, 1.f);
+        __m128 const sum = _mm_setr_ps(add.x, add.y, 0.f, 0.f);
+        for (; index != count; ++index) {
+            float* const floats = &vertices[index].pos.x;
+            _mm_storeu_ps(floats, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(floats), mul), sum));
+        }
+#elif defined(GOOBER_SIMD_NEON)
+        float32x4_t const mul = {multiply.x, multiply.y, 1.f, 1.f};
+        float32x4_t const sum = {add.x, add.y, 0.f, 0.f};
+        for (; index != count; ++index) {
+            float* const floats = &vertices[index].pos.x;
+            vst1q_f32(floats, vmlaq_f32(sum, vld1q_f32(floats), mul));
+        }
+#endif
+
+        for (; index != count; ++index) {
+            grDrawList::CompactVertex& vertex = vertices[index];
+            vertex.pos = {vertex.pos.x * multiply.x + add.x, vertex.pos.y * multiply.y + add.y};
+        }
+    }
+
+    static void transformCallbacks(
+        grArray<grDrawList::Command>& commands,
+        grDrawList::Offset fromVertex,
+        grVec2 multiply,
+        grVec2 add) noexcept {
+        for (grDrawList::Command& cmd : commands) {
+            if (cmd.callback == nullptr || cmd.callbackVertex < fromVertex)
+                continue;
+
+            grVec2 const a{
+                cmd.callbackBounds.minimum.x * multiply.x + add.x,
+                cmd.callbackBounds.minimum.y * multiply.y + add.y};
+            grVec2 const b{
+                cmd.callbackBounds.maximum.x * multiply.x + add.x,
+                cmd.callbackBounds.maximum.y * multiply.y + add.y};
+            // negative factors mirror the bounds
+            cmd.callbackBounds = {
+                {std::fmin(a.x, b.x), std::fmin(a.y, b.y)},
+                {std::fmax(a.x, b.x), std::fmax(a.y, b.y)}};
+        }
+    }
+
+    template <typename VertexT>
+    static void transformFrom(
+        grDrawList& draw,
+        grDrawList::Offset fromVertex,
+        grVec2 multiply,
+        grVec2 add) noexcept {
+        // callbacks have no vertices, so they move by where they were recorded
+        transformCallbacks(draw.commands, fromVertex, multiply, add);
+        for (grDrawList::LayerStream& stream : draw.layerStreams)
+            transformCallbacks(stream.commands, fromVertex, multiply, add);
+
+        grArray<VertexT>& vertices = vertexArray<VertexT>(draw);
+        if (fromVertex >= vertices.size())
+            return;
+
+        std::size_t const count = vertices.size() - fromVertex;
+        transformPositions(vertices.data() + fromVertex, count, multiply, add);
+    }
+
+    void grDrawList::translate(grVec2 offset, Offset fromVertex) {
+        if (uniformColor)
+            transformFrom<CompactVertex>(*this, fromVertex, {1, 1}, offset);
+        else
+            transformFrom<Vertex>(*this, fromVertex, {1, 1}, offset);
+    }
+
+    void grDrawList::scale(grVec2 factor, grVec2 origin, Offset fromVertex) {
+        grVec2 const add{origin.x - origin.x * factor.x, origin.y - origin.y * factor.y};
+        if (uniformColor)
+            transformFrom<CompactVertex>(*this, fromVertex, factor, add);
+        else
+            transformFrom<Vertex>(*this, fromVertex, factor, add);
+    }
+
+    void grDrawList::drawRect(grRect rect, grColor color) {
+        drawImages(0, &rect, nullptr, &color, 1);
     }
 
     void grDrawList::drawRect(grTextureId textureId, grRect rect, grRect texCoord, grColor color) {
-        Offset const vertex = static_cast<Offset>(vertices.size());
-        Offset const index = static_cast<Offset>(indices.size());
+        drawImages(textureId, &rect, &texCoord, &color, 1);
+    }
+
+    void grDrawList::drawRects(grRect const* rects, grColor const* colors, Offset count) {
+        drawImages(0, rects, nullptr, colors, count);
+    }
+
+    void grDrawList::drawImages(
+        grTextureId textureId,
+        grRect const* rects,
+        grRect const* texCoords,
+        grColor const* colors,
+        Offset count) {
+        if (uniformColor)
+            emitQuads<CompactVertex>(*this, textureId, rects, texCoords, colors, count);
+        else
+            emitQuads<Vertex>(*this, textureId, rects, texCoords, colors, count);
+    }
+
+    void grBuildCircleTable(grCircleTable& table) {
+        constexpr double pi = 3.14159265358979323846;
+        // largest allowed gap, in pixels, between a chord and the true arc
+        constexpr double tolerance = 0.25;
+
+        for (int index = 0; index != grCircleTable::tableCount; ++index) {
+            int const segments = (index + 1) * grCircleTable::segmentStep;
+            grVec2* const points =
+                table.points + grCircleTable::segmentStep * index * (index + 1) / 2;
+
+            for (int point = 0; point != segments; ++point) {
+                double const angle = 2.0 * pi * point / segments;
+                points[point] = {
+                    static_cast<float>(std::cos(angle)),
+                    static_cast<float>(std::sin(angle))};
+            }
+
+            table.maxRadius[index] =
+                static_cast<float>(tolerance / (1.0 - std::cos(pi / segments)));
+        }
+    }
+
+    static grCircleTable const& circleTableFor(grDrawList const& draw) {
+        if (draw.circleTable != nullptr)
+            return *draw.circleTable;
+
+        static grCircleTable const fallback = [] {
+            grCircleTable table;
+            grBuildCircleTable(table);
+            return table;
+        }();
+        return fallback;
+    }
+
+    static grVec2 segmentNormal(grVec2 from, grVec2 to) noexcept {
+        grVec2 const delta = to - from;
+        float const lengthSq = delta.x * delta.x + delta.y * delta.y;
+        if (lengthSq <= 0.f)
+            return {};
+
+        float const inverse = 1.f / std::sqrt(lengthSq);
+        return {-delta.y * inverse, delta.x * inverse};
+    }
+
+    // fills a convex polygon whose points run around its edge; the outward unit
+    // normal of each point places the anti-aliased fringe
+    template <typename VertexT>
+    static void fillConvex(
+        grDrawList& draw,
+        grVec2 const* points,
+        grVec2 const* normals,
+        grDrawList::Offset count,
+        grColor color) {
+        using Index = grDrawList::Index;
+        using Offset = grDrawList::Offset;
+
+        bool const fringe = hasVertexColor<VertexT> && draw.feather > 0.f;
+        Offset const vertexCount = fringe ? count * 2 : count;
+        Offset const indexCount = (count - 2) * 3 + (fringe ? count * 6 : 0);
+
+        reserveGeometry(draw, vertexCount, indexCount);
+        grDrawList::Command& cmd = pushCommand(draw, 0, color);
+
+        Offset const base = static_cast<Offset>(vertexArray<VertexT>(draw).size());
+        VertexT* const out = appendVertices<VertexT>(draw, vertexCount, 0);
+        Index* idx = draw.indices.append_uninitialized(indexCount);
+        cmd.indexCount += indexCount;
+
+        Offset const stride = fringe ? 2 : 1;
+        for (Offset point = 1; point + 1 < count; ++point) {
+            *idx++ = static_cast<Index>(base);
+            *idx++ = static_cast<Index>(base + point * stride);
+            *idx++ = static_cast<Index>(base + (point + 1) * stride);
+        }
+
+        if (!fringe) {
+            for (Offset point = 0; point != count; ++point)
+                setVertex(out[point], points[point], color);
+            return;
+        }
+
+        float const half = draw.feather * 0.5f;
+        grColor const transparent(color.r, color.g, color.b, 0);
 
-        Command& cmd = pushCommand(commands, textureId);
+        for (Offset point = 0; point != count; ++point) {
+            setVertex(out[point * 2], points[point] - normals[point] * half, color);
+            setVertex(out[point * 2 + 1], points[point] + normals[point] * half, transparent);
 
-        vertices.push_back({rect.minimum, texCoord.minimum, color});
-        vertices.push_back(
-            {{rect.maximum.x, rect.minimum.y}, {texCoord.maximum.x, texCoord.minimum.y}, color});
-        vertices.push_back({rect.maximum, texCoord.maximum, color});
-        vertices.push_back(
-            {{rect.minimum.x, rect.maximum.y}, {texCoord.minimum.x, texCoord.maximum.y}, color});
+            Offset const inner = base + point * 2;
+            Offset const next = base + (point + 1 == count ? 0 : (point + 1) * 2);
+            *idx++ = static_cast<Index>(inner);
+            *idx++ = static_cast<Index>(inner + 1);
+            *idx++ = static_cast<Index>(next + 1);
+            *idx++ = static_cast<Index>(next + 1);
+            *idx++ = static_cast<Index>(next);
+            *idx++ = static_cast<Index>(inner);
+        }
+    }
+
+    static void fillConvex(
+        grDrawList& draw,
+        grVec2 const* points,
+        grVec2 const* normals,
+        grDrawList::Offset count,
+        grColor color) {
+        if (draw.uniformColor)
+            fillConvex<grDrawList::CompactVertex>(draw, points, normals, count, color);
+        else
+            fillConvex<grDrawList::Vertex>(draw, points, normals, count, color);
+    }
+
+    void grDrawList::drawLine(grVec2 from, grVec2 to, grColor color, float thickness) {
+        grVec2 const points[2] = {from, to};
+        drawPolyline(points, 2, color, thickness, false);
+    }
+
+    template <typename VertexT>
+    static void strokePolyline(
+        grDrawList& draw,
+        grVec2 const* points,
+        grDrawList::Offset count,
+        grColor color,
+        float thickness,
+        bool closed) {
+        using Index = grDrawList::Index;
+        using Offset = grDrawList::Offset;
+
+        float const feather = draw.feather;
+        bool const fringe = hasVertexColor<VertexT> && feather > 0.f;
+        Offset const lanes = fringe ? 3 : 1;
+        Offset const stride = lanes + 1;
+        Offset const segments = closed ? count : count - 1;
+        Offset const vertexCount = count * stride;
+        Offset const indexCount = segments * lanes * 6;
+
+        reserveGeometry(draw, vertexCount, indexCount);
+        grDrawList::Command& cmd = pushCommand(draw, 0, color);
+
+        Offset const base = static_cast<Offset>(vertexArray<VertexT>(draw).size());
+        VertexT* out = appendVertices<VertexT>(draw, vertexCount, 0);
+        Index* idx = draw.indices.append_uninitialized(indexCount);
+        cmd.indexCount += indexCount;
+
+        float const outer = (thickness + (fringe ? feather : 0.f)) * 0.5f;
+        float const core = thickness > feather ? thickness - feather : 0.f;
+        float const inner = fringe ? core * 0.5f : outer;
+        grColor const transparent(color.r, color.g, color.b, 0);
+
+        for (Offset point = 0; point != count; ++point, out += stride) {
+            bool const hasPrev = closed || point != 0;
+            bool const hasNext = closed || point + 1 != count;
+            grVec2 const prevNormal =
+                hasPrev ? segmentNormal(points[point == 0 ? count - 1 : point - 1], points[point])
+                        : grVec2{};
+            grVec2 const nextNormal =
+                hasNext ? segmentNormal(points[point], points[point + 1 == count ? 0 : point + 1])
+                        : grVec2{};
+
+            // miter direction, lengthened so the edges stay parallel to both segments
+            grVec2 miter = hasPrev && hasNext ? (prevNormal + nextNormal) * 0.5f
+                : hasPrev                     ? prevNormal
+                                              : nextNormal;
+            float const lengthSq = miter.x * miter.x + miter.y * miter.y;
+            if (lengthSq > 0.000001f)
+                miter = miter * (1.f / (lengthSq < 0.01f ? 0.01f : lengthSq));
+
+            grVec2 const pos = points[point];
+            if (fringe) {
+                setVertex(out[0], pos + miter * outer, transparent);
+                setVertex(out[1], pos + miter * inner, color);
+                setVertex(out[2], pos - miter * inner, color);
+                setVertex(out[3], pos - miter * outer, transparent);
+            }
+            else {
+                setVertex(out[0], pos + miter * outer, color);
+                setVertex(out[1], pos - miter * outer, color);
+            }
+        }
+
+        for (Offset segment = 0; segment != segments; ++segment) {
+            Offset const from = base + segment * stride;
+            Offset const to = base + (segment + 1 == count ? 0 : (segment + 1) * stride);
+            for (Offset lane = 0; lane != lanes; ++lane) {
+                *idx++ = static_cast<Index>(from + lane);
+                *idx++ = static_cast<Index>(from + lane + 1);
+                *idx++ = static_cast<Index>(to + lane + 1);
+                *idx++ = static_cast<Index>(to + lane + 1);
+                *idx++ = static_cast<Index>(to + lane);
+                *idx++ = static_cast<Index>(from + lane);
+            }
+        }
+    }
+
+    void grDrawList::drawPolyline(
+        grVec2 const* points,
+        Offset count,
+        grColor color,
+        float thickness,
+        bool closed) {
+        if (points == nullptr || count < 2)
+            return;
+
+        if (uniformColor)
+            strokePolyline<CompactVertex>(*this, points, count, color, thickness, closed);
+        else
+            strokePolyline<Vertex>(*this, points, count, color, thickness, closed);
+    }
+
+    void grDrawList::drawCircle(grVec2 center, float radius, grColor color) {
+        if (radius <= 0.f)
+            return;
+
+        grCircleTable const& table = circleTableFor(*this);
+        int const segments = table.segmentsFor(radius);
+        grVec2 const* const unit = table.circle(segments);
+
+        grVec2 points[grCircleTable::maxSegments];
+        for (int point = 0; point != segments; ++point)
+            points[point] = center + unit[point] * radius;
+
+        fillConvex(*this, points, unit, static_cast<Offset>(segments), color);
+    }
+
+    void grDrawList::drawRoundRect(grRect rect, float radius, grColor color) {
+        grVec2 const size = rect.size();
+        float const limit = (size.x < size.y ? size.x : size.y) * 0.5f;
+        if (radius > limit)
+            radius = limit;
+        if (radius <= 0.f) {
+            drawRect(rect, color);
+            return;
+        }
+
+        grCircleTable const& table = circleTableFor(*this);
+        int const segments = table.segmentsFor(radius);
+        int const quarter = segments / 4;
+        grVec2 const* const unit = table.circle(segments);
+
+        // corners in clockwise order, matching the quarters of the unit circle
+        grVec2 const centers[4] = {
+            {rect.maximum.x - radius, rect.maximum.y - radius},
+            {rect.minimum.x + radius, rect.maximum.y - radius},
+            {rect.minimum.x + radius, rect.minimum.y + radius},
+            {rect.maximum.x - radius, rect.minimum.y + radius},
+        };
+
+        grVec2 points[grCircleTable::maxSegments + 4];
+        grVec2 normals[grCircleTable::maxSegments + 4];
+        int count = 0;
+        for (int corner = 0; corner != 4; ++corner) {
+            for (int step = 0; step <= quarter; ++step, ++count) {
+                int const index = corner * quarter + step;
+                normals[count] = unit[index == segments ? 0 : index];
+                points[count] = centers[corner] + normals[count] * radius;
+            }
+        }
+
+        fillConvex(*this, points, normals, static_cast<Offset>(count), color);
+    }
 
-        indices.push_back(vertex + 0);
-        indices.push_back(vertex + 1);
-        indices.push_back(vertex + 2);
-        indices.push_back(vertex + 2);
-        indices.push_back(vertex + 3);
-        indices.push_back(vertex + 0);
+    template <typename VertexT>
+    static void emitGlyphs(
+        grDrawList& draw,
+        grTextureId textureId,
+        grFont const& font,
+        std::uint32_t const* glyphs,
+        float const* pens,
+        grDrawList::Offset count,
+        grVec2 pos,
+        grColor color) {
+        using Offset = grDrawList::Offset;
+
+        grGlyphExtent const* const extents = font.extents.data();
+        grRect const* const texCoords = font.texCoords.data();
+        for (Offset written = 0; written != count;) {
+            Offset const quads = reserveItems(draw, 4, 6, count - written);
+            VertexT* const out = appendQuads<VertexT>(draw, textureId, color, quads);
 
-        cmd.indexCount += 6;
+            for (Offset quad = 0; quad != quads; ++quad) {
+                std::uint32_t const glyph = glyphs[written + quad];
+                writeQuad(
+                    out + quad * 4,
+                    extents[glyph].rect(),
+                    {pos.x + pens[written + quad], pos.y},
+                    texCoords[glyph],
+                    color);
+            }
+            written += quads;
+        }
     }
 
     void grDrawList::drawText(
@@ -81,23 +970,504 @@ inline namespace goober {
 
         pos.y += font->lineHeight;
 
-        for (char ch : text) {
-            grGlyph const* glyph = grFontGetGlyph(font, ch);
-            if (glyph == nullptr)
-                continue;
+        constexpr Offset batchSize = 64;
+        std::uint32_t glyphs[batchSize];
+        float pens[batchSize];
+
+        char const* it = text.begin();
+        char const* const end = text.end();
+        while (it != end) {
+            Offset const count =
+                static_cast<Offset>(grFontGetGlyphs(font, it, end, glyphs, batchSize));
+
+            // pen offsets relative to the start of the batch
+            float advance = 0.f;
+            if (font->monospaceAdvance != 0.f) {
+                for (Offset index = 0; index != count; ++index)
+                    pens[index] = static_cast<float>(index) * font->monospaceAdvance;
+                advance = static_cast<float>(count) * font->monospaceAdvance;
+            }
+            else {
+                for (Offset index = 0; index != count; ++index)
+                    pens[index] = font->advances[glyphs[index]];
+                advance = exclusivePrefixSum(pens, count);
+            }
+
+            if (uniformColor)
+                emitGlyphs<CompactVertex>(*this, textureId, *font, glyphs, pens, count, pos, color);
+            else
+                emitGlyphs<Vertex>(*this, textureId, *font, glyphs, pens, count, pos, color);
+
+            pos.x += advance;
+        }
+    }
+
+    void grDrawList::drawTextRun(
+        grTextureId textureId,
+        grVec2 pos,
+        grColor color,
+        grTextRun const& run) {
+        if (run.font == nullptr)
+            return;
+
+        pos.y += run.size.y;
+
+        grFont const& font = *run.font;
+        std::uint32_t const* const glyphs = run.glyphs.data();
+        Offset const count = static_cast<Offset>(run.glyphs.size());
+        if (uniformColor)
+            emitGlyphs<CompactVertex>(
+                *this, textureId, font, glyphs, run.pens.data(), count, pos, color);
+        else
+            emitGlyphs<Vertex>(*this, textureId, font, glyphs, run.pens.data(), count, pos, color);
+    }
 
-            Offset const vertex = static_cast<Offset>(vertices.size());
-            Offset const index = static_cast<Offset>(indices.size());
+    // copies quads recorded at the origin, moving them by offset
+    static void copyQuadVertices(
+        grDrawList::CompactVertex* out,
+        grDrawList::CompactVertex const* source,
+        grDrawList::Offset count,
+        grVec2 offset,
+        grColor) noexcept {
+        std::memcpy(out, source, count * sizeof(grDrawList::CompactVertex));
+        transformPositions(out, count, {1, 1}, offset);
+    }
+
+    static void copyQuadVertices(
+        grDrawList::Vertex* out,
+        grDrawList::CompactVertex const* source,
+        grDrawList::Offset count,
+        grVec2 offset,
+        grColor color) noexcept {
+#if defined(GOOBER_SIMD_SSE2)
+        __m128 const add = _mm_setr_ps(offset.x, offset.y, 0.f, 0.f);
+        for (grDrawList::Offset index = 0; index != count; ++index) {
+            _mm_storeu_ps(&out[index].pos.x, _mm_add_ps(_mm_loadu_ps(&source[index].pos.x), add));
+            out[index].rgba = color;
+        }
+#elif defined(GOOBER_SIMD_NEON)
+        float32x4_t const add = {offset.x, offset.y, 0.f, 0.f};
+        for (grDrawList::Offset index = 0; index != count; ++index) {
+            vst1q_f32(&out[index].pos.x, vaddq_f32(vld1q_f32(&source[index].pos.x), add));
+            out[index].rgba = color;
+        }
+#else
+        for (grDrawList::Offset index = 0; index != count; ++index)
+            out[index] = {source[index].pos + offset, source[index].uv, color};
+#endif
+    }
+
+    void grDrawList::drawCachedText(
+        grTextureId textureId,
+        grVec2 pos,
+        grColor color,
+        grCachedText const& text) {
+        CompactVertex const* const source = text.quads.data();
+        Offset const quadCount = static_cast<Offset>(text.quads.size() / 4);
+
+        for (Offset written = 0; written != quadCount;) {
+            Offset const quads = reserveItems(*this, 4, 6, quadCount - written);
+            if (uniformColor) {
+                CompactVertex* const out =
+                    appendQuads<CompactVertex>(*this, textureId, color, quads);
+                copyQuadVertices(out, source + written * 4, quads * 4, pos, color);
+            }
+            else {
+                Vertex* const out = appendQuads<Vertex>(*this, textureId, color, quads);
+                copyQuadVertices(out, source + written * 4, quads * 4, pos, color);
+            }
+            written += quads;
+        }
+    }
+
+    void grDrawList::drawCallback(CommandCallback callback, void* userData, grRect bounds) {
+        if (callback == nullptr)
+            return;
+
+        // an unused trailing command is taken over rather than left empty
+        Command* cmd = !commands.empty() ? &commands.back() : nullptr;
+        if (cmd == nullptr || cmd->indexCount != 0 || cmd->callback != nullptr)
+            cmd = &commands.push_back({});
+
+        *cmd = {};
+        cmd->indexStart = static_cast<Offset>(indices.size());
+        cmd->callback = callback;
+        cmd->callbackUserData = userData;
+        cmd->callbackBounds = bounds;
+        cmd->callbackVertex = static_cast<Offset>(recordedVertices(*this));
+    }
+
+    void grDrawList::setLayer(grDrawLayer target) noexcept {
+        if (target == layer)
+            return;
 
-            Command& cmd = commands.empty() ? commands.push_back({index, 0}) : commands.back();
+        LayerStream& parked = layerStreams[static_cast<int>(layer)];
+        indices.swap(parked.indices);
+        commands.swap(parked.commands);
 
-            drawRect(
-                textureId,
-                {pos + glyph->extent.minimum, pos + glyph->extent.maximum},
-                glyph->texCoord,
-                color);
+        LayerStream& active = layerStreams[static_cast<int>(target)];
+        indices.swap(active.indices);
+        commands.swap(active.commands);
 
-            pos.x += glyph->xAdvance;
+        layer = target;
+    }
+
+    void grDrawList::finalize() {
+        setLayer(grDrawLayer::Content);
+
+        int const content = static_cast<int>(grDrawLayer::Content);
+        std::size_t indexSizes[layerCount];
+        std::size_t commandSizes[layerCount];
+        bool layered = false;
+        for (int index = 0; index != layerCount; ++index) {
+            LayerStream const& stream = layerStreams[index];
+            indexSizes[index] = index == content ? indices.size() : stream.indices.size();
+            commandSizes[index] = index == content ? commands.size() : stream.commands.size();
+            layered = layered || (index != content && commandSizes[index] != 0);
+        }
+        if (!layered)
+            return;
+
+        // each layer lands after the sum of the layers beneath it
+        std::size_t indexStarts[layerCount];
+        std::size_t commandStarts[layerCount];
+        std::size_t indexTotal = 0;
+        std::size_t commandTotal = 0;
+        for (int index = 0; index != layerCount; ++index) {
+            indexStarts[index] = indexTotal;
+            commandStarts[index] = commandTotal;
+            indexTotal += indexSizes[index];
+            commandTotal += commandSizes[index];
+        }
+
+        indices.append_uninitialized(indexTotal - indexSizes[content]);
+        commands.append_uninitialized(commandTotal - commandSizes[content]);
+
+        // content is moved first since the layers beneath it overwrite its old position
+        std::memmove(
+            indices.data() + indexStarts[content],
+            indices.data(),
+            indexSizes[content] * sizeof(Index));
+        std::memmove(
+            commands.data() + commandStarts[content],
+            commands.data(),
+            commandSizes[content] * sizeof(Command));
+
+        for (int index = 0; index != layerCount; ++index) {
+            if (index != content) {
+                LayerStream& stream = layerStreams[index];
+                std::memcpy(
+                    indices.data() + indexStarts[index],
+                    stream.indices.data(),
+                    indexSizes[index] * sizeof(Index));
+                std::memcpy(
+                    commands.data() + commandStarts[index],
+                    stream.commands.data(),
+                    commandSizes[index] * sizeof(Command));
+                stream.indices.clear();
+                stream.commands.clear();
+            }
+
+            Command* const cmd = commands.data() + commandStarts[index];
+            for (std::size_t at = 0; at != commandSizes[index]; ++at)
+                cmd[at].indexStart += static_cast<Offset>(indexStarts[index]);
+        }
+
+        // neighbouring layers that ended and began with the same texture share one command
+        std::size_t kept = 0;
+        for (std::size_t at = 1; at != commands.size(); ++at) {
+            Command& last = commands[kept];
+            Command const& cmd = commands[at];
+            if (last.callback == nullptr && sameBindings(*this, last, *this, cmd) &&
+                cmd.indexStart == last.indexStart + last.indexCount)
+                last.indexCount += cmd.indexCount;
+            else
+                commands[++kept] = cmd;
+        }
+        commands.resize(kept + 1);
+    }
+
+    void grDrawList::flush() {
+        if (flushCallback == nullptr)
+            return;
+
+        grDrawLayer const current = layer;
+        finalize();
+
+        if (!commands.empty()) {
+            flushCallback(flushUserData, *this);
+
+            indices.clear();
+            vertices.clear();
+            compactVertices.clear();
+            vertexSlots.clear();
+            slotTextures.clear();
+            commands.clear();
+        }
+
+        setLayer(current);
+    }
+
+    template <typename T>
+    static void copyArray(grArray<T>& to, grArray<T> const& from) {
+        to.clear();
+        if (!from.empty())
+            std::memcpy(to.append_uninitialized(from.size()), from.data(), from.size() * sizeof(T));
+    }
+
+    void grDrawList::copyGeometry(grDrawList const& source) {
+        copyArray(indices, source.indices);
+        copyArray(vertices, source.vertices);
+        copyArray(compactVertices, source.compactVertices);
+        copyArray(vertexSlots, source.vertexSlots);
+        copyArray(slotTextures, source.slotTextures);
+        copyArray(commands, source.commands);
+    }
+
+    static constexpr float unbounded = 3.0e38f;
+
+    static grRect emptyBounds() noexcept {
+        return {{unbounded, unbounded}, {-unbounded, -unbounded}};
+    }
+
+    static bool hasBounds(grRect const& bounds) noexcept {
+        return bounds.minimum.x <= bounds.maximum.x && bounds.minimum.y <= bounds.maximum.y;
+    }
+
+    static void growBounds(grRect& bounds, grVec2 pos) noexcept {
+        bounds.minimum = {
+            pos.x < bounds.minimum.x ? pos.x : bounds.minimum.x,
+            pos.y < bounds.minimum.y ? pos.y : bounds.minimum.y};
+        bounds.maximum = {
+            pos.x > bounds.maximum.x ? pos.x : bounds.maximum.x,
+            pos.y > bounds.maximum.y ? pos.y : bounds.maximum.y};
+    }
+
+    static grRect unionBounds(grRect const& first, grRect const& second) noexcept {
+        grRect bounds = first;
+        growBounds(bounds, second.minimum);
+        growBounds(bounds, second.maximum);
+        return bounds;
+    }
+
+    // bounds of the triangles drawn by a range of indices
+    template <typename VertexT>
+    static void boundIndices(
+        grRect& bounds,
+        grDrawList const& draw,
+        std::size_t first,
+        std::size_t last) noexcept {
+        grArray<VertexT> const& vertices = vertexArray<VertexT>(draw);
+        for (std::size_t index = first; index < last; ++index) {
+            grDrawList::Index const vertex = draw.indices[index];
+            if (vertex < vertices.size())
+                growBounds(bounds, vertices[vertex].pos);
+        }
+    }
+
+    static void appendBounds(grArray<grRect>& damage, grRect const& bounds) {
+        if (hasBounds(bounds))
+            damage.push_back(bounds);
+    }
+
+    template <typename VertexT>
+    static void appendDamage(
+        grDrawList const& previous,
+        grDrawList const& current,
+        grArray<grRect>& damage) {
+        grArray<VertexT> const& before = vertexArray<VertexT>(previous);
+        grArray<VertexT> const& after = vertexArray<VertexT>(current);
+
+        // vertices outside the common prefix and suffix are the ones that changed
+        std::size_t const oldCount = before.size();
+        std::size_t const newCount = after.size();
+        std::size_t const commonCount = oldCount < newCount ? oldCount : newCount;
+
+        // in texture slot mode a vertex also changes when it samples another slot
+        auto const same = [&](std::size_t oldVertex, std::size_t newVertex) {
+            if (std::memcmp(&before[oldVertex], &after[newVertex], sizeof(VertexT)) != 0)
+                return false;
+
+            bool const hadSlot = oldVertex < previous.vertexSlots.size();
+            bool const hasSlot = newVertex < current.vertexSlots.size();
+            if (!hadSlot || !hasSlot)
+                return hadSlot == hasSlot;
+            return previous.vertexSlots[oldVertex] == current.vertexSlots[newVertex];
+        };
+
+        std::size_t prefix = 0;
+        while (prefix != commonCount && same(prefix, prefix))
+            ++prefix;
+
+        std::size_t suffix = 0;
+        while (prefix + suffix != commonCount &&
+               same(oldCount - 1 - suffix, newCount - 1 - suffix))
+            ++suffix;
+
+        // old indices are compared in the new numbering; those naming a changed
+        // vertex never match, so triangles touching it count as changed
+        auto const matches = [&](grDrawList::Index oldIndex, grDrawList::Index newIndex) {
+            if (oldIndex < prefix)
+                return oldIndex == newIndex;
+            if (oldIndex >= oldCount - suffix && oldIndex < oldCount)
+                return oldIndex + newCount - oldCount == newIndex;
+            return false;
+        };
+
+        std::size_t const oldIndices = previous.indices.size();
+        std::size_t const newIndices = current.indices.size();
+        std::size_t const commonIndices = oldIndices < newIndices ? oldIndices : newIndices;
+
+        std::size_t head = 0;
+        while (head != commonIndices && matches(previous.indices[head], current.indices[head]))
+            ++head;
+
+        std::size_t tail = 0;
+        while (head + tail != commonIndices &&
+               matches(
+                   previous.indices[oldIndices - 1 - tail],
+                   current.indices[newIndices - 1 - tail]))
+            ++tail;
+
+        // whole triangles only
+        head -= head % 3;
+        tail -= tail % 3;
+
+        grRect bounds = emptyBounds();
+        boundIndices<VertexT>(bounds, previous, head, oldIndices - tail);
+        boundIndices<VertexT>(bounds, current, head, newIndices - tail);
+        appendBounds(damage, bounds);
+
+        // unchanged triangles still draw differently under a different binding
+        std::size_t const oldCommands = previous.commands.size();
+        std::size_t const newCommands = current.commands.size();
+        std::size_t const commonCommands = oldCommands < newCommands ? oldCommands : newCommands;
+
+        std::size_t first = 0;
+        while (first != commonCommands &&
+               sameBindings(
+                   previous,
+                   previous.commands[first],
+                   current,
+                   current.commands[first]))
+            ++first;
+
+        std::size_t last = 0;
+        while (first + last != commonCommands &&
+               sameBindings(
+                   previous,
+                   previous.commands[oldCommands - 1 - last],
+                   current,
+                   current.commands[newCommands - 1 - last]))
+            ++last;
+
+        bounds = emptyBounds();
+        for (std::size_t index = first; index < oldCommands - last; ++index) {
+            grDrawList::Command const& cmd = previous.commands[index];
+            std::size_t const end = std::size_t{cmd.indexStart} + cmd.indexCount;
+            boundIndices<VertexT>(bounds, previous, cmd.indexStart, end);
+        }
+        for (std::size_t index = first; index < newCommands - last; ++index) {
+            grDrawList::Command const& cmd = current.commands[index];
+            std::size_t const end = std::size_t{cmd.indexStart} + cmd.indexCount;
+            boundIndices<VertexT>(bounds, current, cmd.indexStart, end);
+        }
+        appendBounds(damage, bounds);
+    }
+
+    // what callbacks draw is unknown, so their areas always count as changed
+    static void appendCallbackBounds(grDrawList const& draw, grArray<grRect>& damage) {
+        for (grDrawList::Command const& cmd : draw.commands) {
+            if (cmd.callback != nullptr)
+                appendBounds(damage, cmd.callbackBounds);
+        }
+    }
+
+    void grAppendDamage(
+        grDrawList const& previous,
+        grDrawList const& current,
+        grArray<grRect>& damage) {
+        appendCallbackBounds(previous, damage);
+        appendCallbackBounds(current, damage);
+
+        bool const wasCompact = !previous.compactVertices.empty();
+        bool const isCompact = !current.compactVertices.empty();
+
+        if (wasCompact == isCompact) {
+            if (isCompact)
+                appendDamage<grDrawList::CompactVertex>(previous, current, damage);
+            else
+                appendDamage<grDrawList::Vertex>(previous, current, damage);
+            return;
+        }
+
+        // the vertex formats differ, so everything either list draws has changed
+        grRect bounds = emptyBounds();
+        if (wasCompact)
+            boundIndices<grDrawList::CompactVertex>(bounds, previous, 0, previous.indices.size());
+        else
+            boundIndices<grDrawList::Vertex>(bounds, previous, 0, previous.indices.size());
+        if (isCompact)
+            boundIndices<grDrawList::CompactVertex>(bounds, current, 0, current.indices.size());
+        else
+            boundIndices<grDrawList::Vertex>(bounds, current, 0, current.indices.size());
+        appendBounds(damage, bounds);
+    }
+
+    static float boundsArea(grRect const& bounds) noexcept {
+        grVec2 const size = bounds.size();
+        return size.x * size.y;
+    }
+
+    static bool overlaps(grRect const& first, grRect const& second) noexcept {
+        return first.minimum.x <= second.maximum.x && second.minimum.x <= first.maximum.x &&
+            first.minimum.y <= second.maximum.y && second.minimum.y <= first.maximum.y;
+    }
+
+    // replaces one rect with its union with another, which is then removed
+    static void mergeInto(grArray<grRect>& damage, std::size_t into, std::size_t from) {
+        damage[into] = unionBounds(damage[into], damage[from]);
+        damage[from] = damage.back();
+        damage.pop_back();
+    }
+
+    void grMergeDamage(grArray<grRect>& damage, std::size_t maxRects) {
+        // partially covered pixels change too
+        for (grRect& rect : damage) {
+            rect.minimum = {std::floor(rect.minimum.x), std::floor(rect.minimum.y)};
+            rect.maximum = {std::ceil(rect.maximum.x), std::ceil(rect.maximum.y)};
+        }
+
+        for (bool merged = true; merged;) {
+            merged = false;
+            for (std::size_t first = 0; first < damage.size(); ++first) {
+                for (std::size_t second = first + 1; second < damage.size();) {
+                    if (overlaps(damage[first], damage[second])) {
+                        mergeInto(damage, first, second);
+                        merged = true;
+                    }
+                    else
+                        ++second;
+                }
+            }
+        }
+
+        while (damage.size() > maxRects && damage.size() > 1) {
+            std::size_t bestFirst = 0;
+            std::size_t bestSecond = 1;
+            float bestGrowth = unbounded;
+            for (std::size_t first = 0; first != damage.size(); ++first) {
+                for (std::size_t second = first + 1; second != damage.size(); ++second) {
+                    float const growth = boundsArea(unionBounds(damage[first], damage[second])) -
+                        boundsArea(damage[first]) - boundsArea(damage[second]);
+                    if (growth < bestGrowth) {
+                        bestGrowth = growth;
+                        bestFirst = first;
+                        bestSecond = second;
+                    }
+                }
+            }
+            mergeInto(damage, bestFirst, bestSecond);
         }
     }
 
@@ -2,9 +2,15 @@
 // This is free and unencumbered software released into the public domain.
 // See LICENSE.md for more details.
 
+#include "goober/draw.hh"
 #include "goober/font.hh"
+#include "simd.hh"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
+#include <utility>
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #define STBTT_STATIC
@@ -22,69 +28,282 @@ extern std::size_t goober_proggy_size;
 
 namespace goober {
 
+    // rasterizes glyphs into a dynamic atlas as they are first looked up
+    struct grFontPacker {
+        stbtt_fontinfo fontInfo;
+        stbrp_context context;
+        grArray<stbrp_node> nodes;
+    };
+
+    // gap left to the right of and below each dynamic glyph so filtering does not bleed
+    static constexpr int glyphPadding = 1;
+
+    grFontAtlas::~grFontAtlas() {
+        if (packer != nullptr) {
+            packer->~grFontPacker();
+            grFree(packer);
+        }
+        grFree(data);
+    }
+
+    static void grMarkAtlasDirty(grFontAtlas& atlas, grRect area) {
+        atlas.dirty = true;
+        if (area.size().x <= 0.f || area.size().y <= 0.f)
+            return;
+
+        // merging is quadratic, so the list is kept short between uploads
+        atlas.dirtyRects.push_back(area);
+        if (atlas.dirtyRects.size() > grFontAtlas::maxDirtyRects * 4)
+            grMergeDamage(atlas.dirtyRects, grFontAtlas::maxDirtyRects);
+    }
+
+    static void grMarkAtlasRebuilt(grFontAtlas& atlas) {
+        atlas.dirtyRects.clear();
+        grMarkAtlasDirty(
+            atlas,
+            {{0, 0}, {static_cast<float>(atlas.width), static_cast<float>(atlas.height)}});
+    }
+
+    // doubles the shorter side, so that the atlas alternates between square and twice as wide
+    static bool grGrowAtlasSize(unsigned int& width, unsigned int& height, unsigned int maxSize) {
+        if (width <= height && width < maxSize) {
+            width *= 2;
+            return true;
+        }
+        if (height < maxSize) {
+            height *= 2;
+            return true;
+        }
+        return false;
+    }
+
+    // covers the glyphs with as few ranges as possible; runs of consecutive codepoints stored
+    // in order share one
+    static void grRebuildGlyphRanges(grFont& font) {
+        font.glyphRanges.clear();
+        for (std::size_t index = 0; index != font.glyphs.size(); ++index) {
+            int const codepoint = font.glyphs[index].codepoint;
+            if (!font.glyphRanges.empty()) {
+                grFontGlyphRange& last = font.glyphRanges.back();
+                if (last.codepointStart + last.codepointCount == codepoint &&
+                    last.glyphOffset + last.codepointCount == static_cast<int>(index)) {
+                    ++last.codepointCount;
+                    continue;
+                }
+            }
+            font.glyphRanges.push_back({codepoint, 1, static_cast<int>(index)});
+        }
+    }
+
+    static void grClearGlyphs(grFont& font) {
+        font.glyphs.clear();
+        font.glyphRanges.clear();
+        font.glyphUsed.clear();
+        grFontBuildGlyphLookup(&font);
+    }
+
+    // starts an empty dynamic page holding only the solid white pixel at the origin
+    static void grResetDynamicPage(grFontAtlas& atlas) {
+        std::size_t const bytes = std::size_t{atlas.width} * atlas.height;
+        atlas.data = static_cast<unsigned char*>(grAlloc(bytes));
+        std::memset(atlas.data, 0, bytes);
+        atlas.bpp = 8;
+        atlas.full = false;
+        grMarkAtlasRebuilt(atlas);
+
+        grFontPacker& packer = *atlas.packer;
+        int const width = static_cast<int>(atlas.width);
+        packer.nodes.resize(atlas.width);
+        stbrp_init_target(
+            &packer.context,
+            width,
+            static_cast<int>(atlas.height),
+            packer.nodes.data(),
+            width);
+        stbrp_setup_heuristic(&packer.context, STBRP_HEURISTIC_Skyline_BF_sortHeight);
+
+        stbrp_rect pix = {};
+        pix.w = 1 + glyphPadding;
+        pix.h = 1 + glyphPadding;
+        stbrp_pack_rects(&packer.context, &pix, 1);
+        atlas.data[0] = 0xFF;
+    }
+
     static void grRebuildFontsAndAtlas(grFontAtlas& atlas, grArray<grFont*> const& fonts) {
         grFree(atlas.data);
         atlas.data = nullptr;
 
-        grArray<stbtt_packedchar> packed;
+        if (atlas.dynamic) {
+            if (atlas.packer == nullptr) {
+                atlas.packer = new (grAlloc(sizeof(grFontPacker))) grFontPacker;
+                stbtt_InitFont(
+                    &atlas.packer->fontInfo,
+                    goober_proggy_data,
+                    stbtt_GetFontOffsetForIndex(goober_proggy_data, 0));
+            }
 
-        atlas.width = 512;
-        atlas.height = 512;
-        atlas.data = static_cast<unsigned char*>(grAlloc(atlas.width * atlas.height));
-        atlas.bpp = 8;
+            grResetDynamicPage(atlas);
+            for (grFont* font : fonts) {
+                if (font != nullptr)
+                    grClearGlyphs(*font);
+            }
+            return;
+        }
 
-        stbtt_pack_context packing;
-        stbtt_PackBegin(&packing, atlas.data, atlas.width, atlas.height, 0, 1, nullptr);
+        // printable Latin-1; control characters have no glyphs
+        static constexpr grFontGlyphRange latin1[] = {{0x20, 0x5F, 0}, {0xA0, 0x5F, 0x5F}};
 
-        // ensure we have a default block of pixels that are a solid white
-        stbrp_rect pix;
-        pix.w = 1;
-        pix.h = 1;
-        stbtt_PackFontRangesPackRects(&packing, &pix, 1);
-        assert(pix.x == 0);
-        assert(pix.y == 0);
-        atlas.data[0] = 0xFF;
+        stbtt_fontinfo fontInfo;
+        stbtt_InitFont(
+            &fontInfo,
+            goober_proggy_data,
+            stbtt_GetFontOffsetForIndex(goober_proggy_data, 0));
 
-        for (grFont* font : fonts) {
+        std::size_t glyphCount = 0;
+        for (grFont const* font : fonts) {
             if (font == nullptr)
                 continue;
+            for (grFontGlyphRange const& range : latin1)
+                glyphCount += range.codepointCount;
+        }
 
-            stbtt_fontinfo fontInfo;
-            stbtt_InitFont(
-                &fontInfo,
-                goober_proggy_data,
-                stbtt_GetFontOffsetForIndex(goober_proggy_data, 0));
+        // every font is packed in one pass, tallest glyphs first
+        grArray<stbtt_packedchar> packed;
+        grArray<stbtt_pack_range> ranges;
+        grArray<stbrp_rect> rects;
+        packed.resize(glyphCount);
+        rects.resize(glyphCount);
+        std::size_t offset = 0;
+        for (grFont const* font : fonts) {
+            if (font == nullptr)
+                continue;
 
-            packed.resize(255);
-            stbtt_PackFontRange(
-                &packing,
-                goober_proggy_data,
-                0,
-                STBTT_POINT_SIZE(font->fontSize),
-                0,
-                255,
-                packed.data());
+            for (grFontGlyphRange const& range : latin1) {
+                stbtt_pack_range packRange = {};
+                packRange.font_size = STBTT_POINT_SIZE(font->fontSize);
+                packRange.first_unicode_codepoint_in_range = range.codepointStart;
+                packRange.num_chars = range.codepointCount;
+                packRange.chardata_for_range = packed.data() + offset;
+                ranges.push_back(packRange);
+                offset += range.codepointCount;
+            }
+        }
+        int const rangeCount = static_cast<int>(ranges.size());
+        int const rectCount = static_cast<int>(rects.size());
 
-            float const widthScalar = 1.f / atlas.width;
-            float const heightScalar = 1.f / atlas.height;
+        // start small and grow until everything fits; at maxSize, whatever fits is kept
+        unsigned int width = grFontAtlas::minSize;
+        unsigned int height = grFontAtlas::minSize;
+        stbtt_pack_context packing = {};
+        for (;;) {
+            unsigned int grownWidth = width;
+            unsigned int grownHeight = height;
+            bool const canGrow = grGrowAtlasSize(grownWidth, grownHeight, atlas.maxSize);
 
-            font->glyphs.clear();
-            font->glyphs.reserve(packed.size());
+            stbtt_PackBegin(&packing, nullptr, width, height, 0, 1, nullptr);
+            stbrp_setup_heuristic(
+                static_cast<stbrp_context*>(packing.pack_info),
+                STBRP_HEURISTIC_Skyline_BF_sortHeight);
 
-            font->glyphRanges.clear();
-            font->glyphRanges.push_back({0, 255, 0});
+            // ensure we have a default block of pixels that are a solid white
+            stbrp_rect pix = {};
+            pix.w = 1 + glyphPadding;
+            pix.h = 1 + glyphPadding;
+            stbtt_PackFontRangesPackRects(&packing, &pix, 1);
+            assert(pix.x == 0);
+            assert(pix.y == 0);
 
-            for (int index = 0; index != 255; ++index) {
-                stbtt_packedchar const& pchar = packed[index];
-                grRect const extent{{pchar.xoff, pchar.yoff}, {pchar.xoff2, pchar.yoff2}};
-                grRect const uv{
-                    {pchar.x0 * widthScalar, pchar.y0 * heightScalar},
-                    {pchar.x1 * widthScalar, pchar.y1 * heightScalar}};
-                font->glyphs.push_back({index, pchar.xadvance, extent, uv});
+            stbtt_PackFontRangesGatherRects(
+                &packing,
+                &fontInfo,
+                ranges.data(),
+                rangeCount,
+                rects.data());
+            std::size_t area = 0;
+            for (stbrp_rect const& rect : rects)
+                area += std::size_t{rect.w} * rect.h;
+
+            bool packedAll = false;
+            if (!canGrow || area <= std::size_t{width} * height) {
+                stbtt_PackFontRangesPackRects(&packing, rects.data(), rectCount);
+                packedAll = std::all_of(rects.begin(), rects.end(), [](stbrp_rect const& rect) {
+                    return rect.was_packed != 0;
+                });
             }
+            if (packedAll || !canGrow)
+                break;
+
+            stbtt_PackEnd(&packing);
+            width = grownWidth;
+            height = grownHeight;
         }
 
+        atlas.width = width;
+        atlas.height = height;
+        atlas.data = static_cast<unsigned char*>(grAlloc(std::size_t{width} * height));
+        std::memset(atlas.data, 0, std::size_t{width} * height);
+        atlas.data[0] = 0xFF;
+        atlas.bpp = 8;
+        grMarkAtlasRebuilt(atlas);
+
+        packing.pixels = atlas.data;
+        stbtt_PackFontRangesRenderIntoRects(
+            &packing,
+            &fontInfo,
+            ranges.data(),
+            rangeCount,
+            rects.data());
         stbtt_PackEnd(&packing);
+
+        float const widthScalar = 1.f / atlas.width;
+        float const heightScalar = 1.f / atlas.height;
+
+        atlas.droppedGlyphs = 0;
+        std::size_t next = 0;
+        for (grFont* font : fonts) {
+            if (font == nullptr)
+                continue;
+
+            font->glyphs.clear();
+            for (grFontGlyphRange const& range : latin1) {
+                for (int index = 0; index != range.codepointCount; ++index, ++next) {
+                    if (rects[next].was_packed == 0) {
+                        ++atlas.droppedGlyphs;
+                        continue;
+                    }
+
+                    stbtt_packedchar const& pchar = packed[next];
+                    grRect const extent{{pchar.xoff, pchar.yoff}, {pchar.xoff2, pchar.yoff2}};
+                    grRect const uv{
+                        {pchar.x0 * widthScalar, pchar.y0 * heightScalar},
+                        {pchar.x1 * widthScalar, pchar.y1 * heightScalar}};
+                    font->glyphs.push_back(
+                        {range.codepointStart + index, pchar.xadvance, extent, uv});
+                }
+            }
+
+            grRebuildGlyphRanges(*font);
+            grFontBuildGlyphLookup(font);
+        }
+    }
+
+    // baked atlases are rebuilt with the current fonts when next fetched; dynamic ones add a
+    // new font's glyphs as they are looked up
+    static void grInvalidateBakedAtlas(grFontAtlas& atlas) {
+        atlas.dirty = true;
+        if (atlas.dynamic)
+            return;
+
+        grFree(atlas.data);
+        atlas.data = nullptr;
+    }
+
+    static void grClearTextCache(grContext* context) {
+        if (context->textCache == nullptr)
+            return;
+
+        context->textCache->entries.clear();
+        context->textCache->slots.clear();
     }
 
     grResult<grFontId> grCreateDefaultFont(grContext* context) {
@@ -94,7 +313,9 @@ namespace goober {
         grFontId const id = static_cast<grFontId>(context->fonts.size());
         grFont* font = context->fonts.push_back(new (grAlloc(sizeof(grFont))) grFont());
         font->fontId = id;
-        context->fontAtlas->dirty = true;
+        font->context = context;
+        grInvalidateBakedAtlas(*context->fontAtlas);
+        grClearTextCache(context);
         return id;
     }
 
@@ -122,21 +343,381 @@ namespace goober {
 
         font->~grFont();
         grFree(font);
-        font = nullptr;
-        context->fontAtlas->dirty = true;
+        context->fonts[fontId] = nullptr;
+        grInvalidateBakedAtlas(*context->fontAtlas);
+        grClearTextCache(context);
         return grStatus::Ok;
     }
 
-    grGlyph const* grFontGetGlyph(grFont const* font, int codepoint) {
+    static grGlyphExtent grQuantizeExtent(grRect const& extent) noexcept {
+        auto const quantize = [](float value) {
+            return static_cast<std::int16_t>(std::lround(value / grGlyphExtent::unit));
+        };
+
+        return {
+            quantize(extent.minimum.x),
+            quantize(extent.minimum.y),
+            quantize(extent.maximum.x),
+            quantize(extent.maximum.y)};
+    }
+
+    void grFontBuildGlyphLookup(grFont* font) {
         if (font == nullptr)
+            return;
+
+        grArray<grFontGlyphRange>& ranges = font->glyphRanges;
+        std::sort(
+            ranges.begin(),
+            ranges.end(),
+            [](grFontGlyphRange const& lhs, grFontGlyphRange const& rhs) {
+                return lhs.codepointStart < rhs.codepointStart;
+            });
+
+        for (std::int32_t& slot : font->directGlyphs)
+            slot = 0;
+
+        int const glyphCount = static_cast<int>(font->glyphs.size());
+        for (grFontGlyphRange const& range : ranges) {
+            for (int offset = 0; offset != range.codepointCount; ++offset) {
+                int const codepoint = range.codepointStart + offset;
+                int const glyph = range.glyphOffset + offset;
+                if (codepoint < 0 || glyph >= glyphCount)
+                    continue;
+                if (codepoint >= grFont::directGlyphCount)
+                    break;
+                if (font->directGlyphs[codepoint] == 0)
+                    font->directGlyphs[codepoint] = glyph + 1;
+            }
+        }
+
+        font->hasPrintableAscii = true;
+        for (int codepoint = 0x20; codepoint != 0x7F; ++codepoint)
+            font->hasPrintableAscii =
+                font->hasPrintableAscii && font->directGlyphs[codepoint] != 0;
+
+        font->advances.resize(font->glyphs.size());
+        font->extents.resize(font->glyphs.size());
+        font->texCoords.resize(font->glyphs.size());
+        for (std::size_t index = 0; index != font->glyphs.size(); ++index) {
+            grGlyph& glyph = font->glyphs[index];
+            font->extents[index] = grQuantizeExtent(glyph.extent);
+
+            // records agree with what is drawn
+            glyph.extent = font->extents[index].rect();
+            font->advances[index] = glyph.xAdvance;
+            font->texCoords[index] = glyph.texCoord;
+        }
+
+        font->monospaceAdvance = !font->advances.empty() ? font->advances[0] : 0.f;
+        for (float const advance : font->advances) {
+            if (advance != font->monospaceAdvance)
+                font->monospaceAdvance = 0.f;
+        }
+    }
+
+    static bool grIsDynamic(grFont const* font) noexcept {
+        return font->context != nullptr && font->context->fontAtlas->dynamic;
+    }
+
+    // glyphs looked up from here on are stamped with the current frame
+    static std::uint64_t grGlyphStamp(grFont const* font) noexcept {
+        return font->context->frame + 1;
+    }
+
+    static void grStampGlyphs(grFont const* font, std::uint32_t const* glyphs, std::size_t count) {
+        std::uint64_t const stamp = grGlyphStamp(font);
+        grFont& dynamicFont = const_cast<grFont&>(*font);
+        for (std::size_t index = 0; index != count; ++index)
+            dynamicFont.glyphUsed[glyphs[index]] = stamp;
+    }
+
+    // adds a glyph without rebuilding the lookup tables
+    static void grAppendGlyph(grFont& font, grGlyph const& glyph) {
+        std::uint32_t const index = static_cast<std::uint32_t>(font.glyphs.size());
+        grGlyphExtent const extent = grQuantizeExtent(glyph.extent);
+
+        grGlyph& added = font.glyphs.push_back(glyph);
+        added.extent = extent.rect();
+        font.advances.push_back(glyph.xAdvance);
+        font.extents.push_back(extent);
+        font.texCoords.push_back(glyph.texCoord);
+        font.glyphUsed.push_back(0);
+
+        int const codepoint = glyph.codepoint;
+        if (codepoint < grFont::directGlyphCount)
+            font.directGlyphs[codepoint] = static_cast<std::int32_t>(index + 1);
+
+        // ranges stay sorted
+        grFontGlyphRange const range{codepoint, 1, static_cast<int>(index)};
+        font.glyphRanges.push_back(range);
+        std::size_t at = font.glyphRanges.size() - 1;
+        for (; at != 0 && font.glyphRanges[at - 1].codepointStart > codepoint; --at)
+            font.glyphRanges[at] = font.glyphRanges[at - 1];
+        font.glyphRanges[at] = range;
+
+        if (codepoint >= 0x20 && codepoint < 0x7F) {
+            font.hasPrintableAscii = true;
+            for (int ascii = 0x20; ascii != 0x7F; ++ascii)
+                font.hasPrintableAscii = font.hasPrintableAscii && font.directGlyphs[ascii] != 0;
+        }
+
+        if (index == 0)
+            font.monospaceAdvance = glyph.xAdvance;
+        else if (glyph.xAdvance != font.monospaceAdvance)
+            font.monospaceAdvance = 0.f;
+    }
+
+    // rasterizes a glyph into a dynamic atlas; fails for control characters, codepoints the
+    // font lacks, and when the atlas has no room left this frame
+    static grGlyph const* grAddDynamicGlyph(grFont& font, int codepoint) {
+        if (codepoint < 0x20 || (codepoint >= 0x7F && codepoint < 0xA0))
+            return nullptr;
+
+        grContext* const context = font.context;
+        grFontAtlas& atlas = *context->fontAtlas;
+        if (atlas.full)
+            return nullptr;
+        if (atlas.data == nullptr)
+            grRebuildFontsAndAtlas(atlas, context->fonts);
+
+        stbtt_fontinfo const& info = atlas.packer->fontInfo;
+        int const glyphIndex = stbtt_FindGlyphIndex(&info, codepoint);
+        if (glyphIndex == 0)
             return nullptr;
 
-        for (grFontGlyphRange const& rng : font->glyphRanges) {
-            if (rng.codepointStart < codepoint && rng.codepointStart + rng.codepointCount)
-                return &font->glyphs[(codepoint - rng.codepointStart) + rng.glyphOffset];
+        float const scale = stbtt_ScaleForMappingEmToPixels(&info, font.fontSize);
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = 0;
+        int y1 = 0;
+        stbtt_GetGlyphBitmapBox(&info, glyphIndex, scale, scale, &x0, &y0, &x1, &y1);
+
+        stbrp_rect rect = {};
+        rect.w = static_cast<stbrp_coord>(x1 - x0 + glyphPadding);
+        rect.h = static_cast<stbrp_coord>(y1 - y0 + glyphPadding);
+        if (stbrp_pack_rects(&atlas.packer->context, &rect, 1) == 0) {
+            atlas.full = true;
+            return nullptr;
         }
 
-        return nullptr;
+        stbtt_MakeGlyphBitmap(
+            &info,
+            atlas.data + rect.y * std::size_t{atlas.width} + rect.x,
+            x1 - x0,
+            y1 - y0,
+            static_cast<int>(atlas.width),
+            scale,
+            scale,
+            glyphIndex);
+        grMarkAtlasDirty(
+            atlas,
+            {{static_cast<float>(rect.x), static_cast<float>(rect.y)},
+             {static_cast<float>(rect.x + x1 - x0), static_cast<float>(rect.y + y1 - y0)}});
+
+        int advance = 0;
+        int bearing = 0;
+        stbtt_GetGlyphHMetrics(&info, glyphIndex, &advance, &bearing);
+
+        float const widthScalar = 1.f / atlas.width;
+        float const heightScalar = 1.f / atlas.height;
+        grGlyph const glyph{
+            codepoint,
+            advance * scale,
+            {{static_cast<float>(x0), static_cast<float>(y0)},
+             {static_cast<float>(x1), static_cast<float>(y1)}},
+            {{rect.x * widthScalar, rect.y * heightScalar},
+             {(rect.x + x1 - x0) * widthScalar, (rect.y + y1 - y0) * heightScalar}}};
+        grAppendGlyph(font, glyph);
+        return &font.glyphs.back();
+    }
+
+    static grGlyph const* grFindGlyph(grFont const* font, int codepoint) {
+        if (codepoint < grFont::directGlyphCount) {
+            std::int32_t const slot = font->directGlyphs[codepoint];
+            return slot != 0 ? &font->glyphs[slot - 1] : nullptr;
+        }
+
+        // find the last range starting at or before the codepoint
+        grFontGlyphRange const* first = font->glyphRanges.begin();
+        std::size_t count = font->glyphRanges.size();
+        while (count != 0) {
+            std::size_t const half = count / 2;
+            if (first[half].codepointStart <= codepoint) {
+                first += half + 1;
+                count -= half + 1;
+            }
+            else
+                count = half;
+        }
+        if (first == font->glyphRanges.begin())
+            return nullptr;
+
+        grFontGlyphRange const& range = first[-1];
+        int const offset = codepoint - range.codepointStart;
+        if (offset >= range.codepointCount)
+            return nullptr;
+
+        std::size_t const glyph = static_cast<std::size_t>(range.glyphOffset + offset);
+        return glyph < font->glyphs.size() ? &font->glyphs[glyph] : nullptr;
+    }
+
+    grGlyph const* grFontGetGlyph(grFont const* font, int codepoint) {
+        if (font == nullptr || codepoint < 0)
+            return nullptr;
+
+        grGlyph const* glyph = grFindGlyph(font, codepoint);
+        if (!grIsDynamic(font))
+            return glyph;
+
+        // dynamic lookups add missing glyphs and record use, so they modify the font
+        grFont& dynamicFont = const_cast<grFont&>(*font);
+        if (glyph == nullptr)
+            glyph = grAddDynamicGlyph(dynamicFont, codepoint);
+        if (glyph != nullptr)
+            dynamicFont.glyphUsed[glyph - font->glyphs.data()] = grGlyphStamp(font);
+        return glyph;
+    }
+
+    int grDecodeUtf8(char const*& it, char const* end) noexcept {
+        constexpr int replacement = 0xFFFD;
+
+        auto const byte = [](char const* at) { return static_cast<unsigned char>(*at); };
+
+        unsigned char const lead = byte(it);
+        if (lead < 0x80) {
+            ++it;
+            return lead;
+        }
+
+        int length = 0;
+        int codepoint = 0;
+        int minimum = 0;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+            codepoint = lead & 0x1F;
+            minimum = 0x80;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            codepoint = lead & 0x0F;
+            minimum = 0x800;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            codepoint = lead & 0x07;
+            minimum = 0x10000;
+        }
+
+        if (length == 0 || end - it < length) {
+            ++it;
+            return replacement;
+        }
+
+        for (int index = 1; index != length; ++index) {
+            unsigned char const next = byte(it + index);
+            if ((next & 0xC0) != 0x80) {
+                ++it;
+                return replacement;
+            }
+            codepoint = (codepoint << 6) | (next & 0x3F);
+        }
+
+        // overlong forms, surrogates, and values past the Unicode range are malformed
+        if (codepoint < minimum || codepoint > 0x10FFFF ||
+            (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+            ++it;
+            return replacement;
+        }
+
+        it += length;
+        return codepoint;
+    }
+
+    // true when none of the 16 bytes has its high bit set
+    static bool grIsAsciiBlock(char const* bytes) noexcept {
+#if defined(GOOBER_SIMD_SSE2)
+        __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes));
+        return _mm_movemask_epi8(block) == 0;
+#elif defined(GOOBER_SIMD_NEON)
+        uint64x2_t const high =
+            vreinterpretq_u64_u8(vshrq_n_u8(vld1q_u8(reinterpret_cast<uint8_t const*>(bytes)), 7));
+        return (vgetq_lane_u64(high, 0) | vgetq_lane_u64(high, 1)) == 0;
+#else
+        std::uint64_t words[2];
+        std::memcpy(words, bytes, sizeof(words));
+        return ((words[0] | words[1]) & 0x8080808080808080ull) == 0;
+#endif
+    }
+
+    static bool grIsPrintableAscii(unsigned char byte) noexcept {
+        return byte >= 0x20 && byte < 0x7F;
+    }
+
+    // looks an all-ASCII block up in the direct table; missing glyphs are written and then
+    // overwritten, so no byte needs a branch. Fails without writing anything when a dynamic
+    // font has yet to add one of the block's printable characters.
+    static bool grLookupAsciiBlock(
+        grFont const* font,
+        char const* bytes,
+        std::size_t size,
+        std::uint32_t* glyphs,
+        std::size_t& count,
+        bool dynamic) noexcept {
+        std::size_t written = count;
+        bool unresolved = false;
+        for (std::size_t index = 0; index != size; ++index) {
+            unsigned char const byte = static_cast<unsigned char>(bytes[index]);
+            std::int32_t const slot = font->directGlyphs[byte];
+            glyphs[written] = static_cast<std::uint32_t>(slot - 1);
+            written += slot != 0;
+            unresolved |= (slot == 0) & grIsPrintableAscii(byte);
+        }
+
+        if (dynamic && unresolved)
+            return false;
+
+        count = written;
+        return true;
+    }
+
+    std::size_t grFontGetGlyphs(
+        grFont const* font,
+        char const*& it,
+        char const* end,
+        std::uint32_t* glyphs,
+        std::size_t maxGlyphs) {
+        if (font == nullptr) {
+            it = end;
+            return 0;
+        }
+
+        constexpr std::size_t blockSize = 16;
+
+        bool const dynamic = grIsDynamic(font);
+        std::size_t count = 0;
+        while (it != end && count != maxGlyphs) {
+            if (maxGlyphs - count >= blockSize * 2 && end - it >= std::ptrdiff_t{blockSize} * 2 &&
+                grIsAsciiBlock(it) && grIsAsciiBlock(it + blockSize) &&
+                grLookupAsciiBlock(font, it, blockSize * 2, glyphs, count, dynamic)) {
+                it += blockSize * 2;
+                continue;
+            }
+            if (maxGlyphs - count >= blockSize && end - it >= std::ptrdiff_t{blockSize} &&
+                grIsAsciiBlock(it) &&
+                grLookupAsciiBlock(font, it, blockSize, glyphs, count, dynamic)) {
+                it += blockSize;
+                continue;
+            }
+
+            grGlyph const* const glyph = grFontGetGlyph(font, grDecodeUtf8(it, end));
+            if (glyph != nullptr)
+                glyphs[count++] = static_cast<std::uint32_t>(glyph - font->glyphs.data());
+        }
+
+        if (dynamic)
+            grStampGlyphs(font, glyphs, count);
+
+        return count;
     }
 
     grGlyph const* grFontGetGlyph(grContext* context, grFontId fontId, int codepoint) {
@@ -146,22 +727,231 @@ namespace goober {
         return grFontGetGlyph(grGetFont(context, fontId), codepoint);
     }
 
+    static void grRebuildTextCacheSlots(grTextCache& cache) {
+        std::size_t capacity = 16;
+        while (capacity < cache.entries.size() * 2)
+            capacity *= 2;
+
+        cache.slots.resize(capacity);
+        for (std::uint32_t& slot : cache.slots)
+            slot = 0;
+
+        std::size_t const mask = capacity - 1;
+        for (std::size_t index = 0; index != cache.entries.size(); ++index) {
+            std::size_t slot = cache.entries[index].hash & mask;
+            while (cache.slots[slot] != 0)
+                slot = (slot + 1) & mask;
+            cache.slots[slot] = static_cast<std::uint32_t>(index + 1);
+        }
+    }
+
+    static void grSweepTextCache(grTextCache& cache, std::uint64_t frame) {
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index != cache.entries.size(); ++index) {
+            grCachedText& entry = cache.entries[index];
+            if (frame - entry.lastUsed >= cache.maxAge)
+                continue;
+            if (kept != index)
+                cache.entries[kept] = std::move(entry);
+            ++kept;
+        }
+
+        cache.entries.resize(kept);
+        cache.sweptFrame = frame;
+        grRebuildTextCacheSlots(cache);
+    }
+
+    // true when every byte is printable ASCII, from space to tilde
+    static bool grIsPrintableAsciiText(grStringView text) noexcept {
+        [[maybe_unused]] constexpr std::size_t blockSize = 16;
+
+        char const* it = text.begin();
+#if defined(GOOBER_SIMD_SSE2)
+        // bytes with the high bit set compare as negative, so below space
+        __m128i const space = _mm_set1_epi8(0x20);
+        __m128i const del = _mm_set1_epi8(0x7F);
+        for (; text.end() - it >= std::ptrdiff_t{blockSize}; it += blockSize) {
+            __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(it));
+            __m128i const bad =
+                _mm_or_si128(_mm_cmplt_epi8(block, space), _mm_cmpeq_epi8(block, del));
+            if (_mm_movemask_epi8(bad) != 0)
+                return false;
+        }
+#elif defined(GOOBER_SIMD_NEON)
+        uint8x16_t const space = vdupq_n_u8(0x20);
+        uint8x16_t const del = vdupq_n_u8(0x7F);
+        for (; text.end() - it >= std::ptrdiff_t{blockSize}; it += blockSize) {
+            uint8x16_t const block = vld1q_u8(reinterpret_cast<uint8_t const*>(it));
+            uint64x2_t const bad = vreinterpretq_u64_u8(
+                vorrq_u8(vcltq_u8(block, space), vcgeq_u8(block, del)));
+            if ((vgetq_lane_u64(bad, 0) | vgetq_lane_u64(bad, 1)) != 0)
+                return false;
+        }
+#endif
+
+        for (; it != text.end(); ++it) {
+            if (!grIsPrintableAscii(static_cast<unsigned char>(*it)))
+                return false;
+        }
+        return true;
+    }
+
+    static grVec2 grMeasureGlyphs(grFont const* font, grStringView text) {
+        grVec2 size{0, font->lineHeight};
+
+        // monospace ASCII needs neither lookups nor a sum, unless the lookups must record use
+        if (font->monospaceAdvance != 0.f && font->hasPrintableAscii && !grIsDynamic(font) &&
+            grIsPrintableAsciiText(text)) {
+            size.x = static_cast<float>(text.size()) * font->monospaceAdvance;
+            return size;
+        }
+
+        constexpr std::size_t batchSize = 64;
+        std::uint32_t glyphs[batchSize];
+
+        float const* const advances = font->advances.data();
+        char const* it = text.begin();
+        while (it != text.end()) {
+            std::size_t const count = grFontGetGlyphs(font, it, text.end(), glyphs, batchSize);
+            if (font->monospaceAdvance != 0.f) {
+                size.x += static_cast<float>(count) * font->monospaceAdvance;
+                continue;
+            }
+            for (std::size_t index = 0; index != count; ++index)
+                size.x += advances[glyphs[index]];
+        }
+
+        return size;
+    }
+
+    void grFontLayoutText(grFont const* font, grStringView text, grTextRun& run) {
+        run.font = font;
+        run.glyphs.clear();
+        run.pens.clear();
+        run.size = {};
+        if (font == nullptr)
+            return;
+
+        // each glyph consumes at least one byte
+        run.glyphs.resize(text.size());
+        char const* it = text.begin();
+        std::size_t const count =
+            grFontGetGlyphs(font, it, text.end(), run.glyphs.data(), text.size());
+        run.glyphs.resize(count);
+
+        run.pens.resize(count);
+        float pen = 0.f;
+        if (font->monospaceAdvance != 0.f) {
+            for (std::size_t index = 0; index != count; ++index)
+                run.pens[index] = static_cast<float>(index) * font->monospaceAdvance;
+            pen = static_cast<float>(count) * font->monospaceAdvance;
+        }
+        else {
+            for (std::size_t index = 0; index != count; ++index) {
+                run.pens[index] = pen;
+                pen += font->advances[run.glyphs[index]];
+            }
+        }
+
+        run.size = {pen, font->lineHeight};
+    }
+
+    // finds or adds the cache entry for the text, or returns nullptr if the context has no cache
+    static grCachedText* grGetCachedText(
+        grContext* context,
+        grFont const* font,
+        grFontId fontId,
+        grStringView text) {
+        grTextCache* const cache = context->textCache;
+        if (cache == nullptr)
+            return nullptr;
+
+        // sweeping once per maxAge frames keeps entries for between maxAge and twice that
+        if (context->frame - cache->sweptFrame >= cache->maxAge)
+            grSweepTextCache(*cache, context->frame);
+
+        std::uint64_t const hash = grHashCombine(grHashFnv1a(text), fontId);
+        std::size_t const mask = cache->slots.size() - 1;
+        std::size_t slot = hash & mask;
+        for (; !cache->slots.empty() && cache->slots[slot] != 0; slot = (slot + 1) & mask) {
+            grCachedText& entry = cache->entries[cache->slots[slot] - 1];
+            if (entry.hash != hash || entry.fontId != fontId ||
+                entry.text.size() != text.size() ||
+                std::memcmp(entry.text.begin(), text.begin(), text.size()) != 0)
+                continue;
+
+            // cache hits skip the lookups, so they record the use of the drawn glyphs instead
+            entry.lastUsed = context->frame;
+            if (!entry.glyphs.empty() && grIsDynamic(font))
+                grStampGlyphs(font, entry.glyphs.data(), entry.glyphs.size());
+            return &entry;
+        }
+
+        // text seen for the first time, or again within its first frame, is not cached yet
+        std::uint64_t const seen = context->frame + 1;
+        grTextCache::Candidate& candidate =
+            cache->candidates[hash & (grTextCache::candidateCount - 1)];
+        if (candidate.seen == 0 || candidate.hash != hash ||
+            seen - candidate.seen > cache->maxAge) {
+            candidate = {hash, seen};
+            return nullptr;
+        }
+        if (candidate.seen == seen)
+            return nullptr;
+        candidate = {};
+
+        std::size_t const index = cache->entries.size();
+        if (index == cache->entries.capacity())
+            cache->entries.reserve(index != 0 ? index * 2 : 16);
+        cache->entries.resize(index + 1);
+
+        grCachedText& entry = cache->entries.back();
+        entry.fontId = fontId;
+        entry.hash = hash;
+        entry.text = grString(text);
+        entry.size = grMeasureGlyphs(font, text);
+        entry.lastUsed = context->frame;
+
+        if (cache->entries.size() * 2 > cache->slots.size())
+            grRebuildTextCacheSlots(*cache);
+        else
+            cache->slots[slot] = static_cast<std::uint32_t>(index + 1);
+
+        return &entry;
+    }
+
     grVec2 grFontMeasureText(grContext* context, grFontId fontId, grStringView text) {
         grFont const* font = grGetFont(context, fontId);
         if (font == nullptr)
             return {};
 
-        grVec2 size{0, font->lineHeight};
+        grCachedText const* const entry = grGetCachedText(context, font, fontId, text);
+        return entry != nullptr ? entry->size : grMeasureGlyphs(font, text);
+    }
 
-        for (char ch : text) {
-            grGlyph const* glyph = grFontGetGlyph(font, ch);
-            if (glyph == nullptr)
-                continue;
+    grCachedText const* grFontGetCachedText(
+        grContext* context,
+        grFontId fontId,
+        grStringView text) {
+        grFont const* font = grGetFont(context, fontId);
+        if (font == nullptr)
+            return nullptr;
 
-            size.x += glyph->xAdvance;
-        }
+        grCachedText* const entry = grGetCachedText(context, font, fontId, text);
+        if (entry == nullptr || entry->quadsBuilt)
+            return entry;
 
-        return size;
+        // the quads are whatever a uniform color list records for the text at the origin
+        grTextRun run;
+        grFontLayoutText(font, text, run);
+        grDrawList scratch;
+        scratch.uniformColor = true;
+        scratch.drawTextRun(0, {0, 0}, grColors::white, run);
+        entry->quads.swap(scratch.compactVertices);
+        if (grIsDynamic(font))
+            entry->glyphs.swap(run.glyphs);
+        entry->quadsBuilt = true;
+        return entry;
     }
 
     grFontAtlas const* grGetFontAtlasIfDirtyAlpha8(grContext* context) {
@@ -172,19 +962,171 @@ namespace goober {
             return nullptr;
 
         if (context->fontAtlas->data == nullptr || context->fontAtlas->bpp != 8) {
-            grFree(context->fontAtlas->data);
             grRebuildFontsAndAtlas(*context->fontAtlas, context->fonts);
+            grClearTextCache(context);
         }
 
+        grMergeDamage(context->fontAtlas->dirtyRects, grFontAtlas::maxDirtyRects);
         return context->fontAtlas;
     }
 
+    grStatus grSetFontAtlasDynamic(grContext* context, bool dynamic, unsigned int size) {
+        if (context == nullptr)
+            return grStatus::NullArgument;
+        if (context->parent != nullptr || (dynamic && !context->builders.empty()))
+            return grStatus::Unsupported;
+        if (dynamic && size == 0)
+            return grStatus::Empty;
+
+        grFontAtlas& atlas = *context->fontAtlas;
+        atlas.dynamic = dynamic;
+        if (dynamic) {
+            atlas.width = size;
+            atlas.height = size;
+        }
+
+        // rebuilt when next needed
+        grFree(atlas.data);
+        atlas.data = nullptr;
+        atlas.full = false;
+        atlas.dirty = true;
+        for (grFont* font : context->fonts) {
+            if (font != nullptr)
+                grClearGlyphs(*font);
+        }
+        grClearTextCache(context);
+        return grStatus::Ok;
+    }
+
+    void grFontAtlasBeginFrame(grContext* context) {
+        if (context == nullptr)
+            return;
+
+        grFontAtlas& atlas = *context->fontAtlas;
+        if (!atlas.dynamic || !atlas.full)
+            return;
+
+        unsigned char* const previous = atlas.data;
+        std::size_t const previousPitch = atlas.width;
+        float const previousWidth = static_cast<float>(atlas.width);
+        float const previousHeight = static_cast<float>(atlas.height);
+
+        // a full page grows while it can and keeps every glyph; at maxSize, the glyphs not
+        // used during the last frame are evicted instead
+        bool const grow = grGrowAtlasSize(atlas.width, atlas.height, atlas.maxSize);
+        grResetDynamicPage(atlas);
+
+        std::uint64_t const frame = context->frame;
+        auto const keep = [grow, frame](grFont const& font, std::size_t index) {
+            return grow || font.glyphUsed[index] >= frame;
+        };
+
+        // the kept glyphs are packed together, tallest first, which wastes less room than the
+        // order they were added in
+        grArray<stbrp_rect> rects;
+        for (grFont const* font : context->fonts) {
+            if (font == nullptr)
+                continue;
+
+            for (std::size_t index = 0; index != font->glyphs.size(); ++index) {
+                if (!keep(*font, index))
+                    continue;
+
+                grVec2 const size = font->glyphs[index].extent.size();
+                stbrp_rect rect = {};
+                rect.w = static_cast<stbrp_coord>(std::lround(size.x) + glyphPadding);
+                rect.h = static_cast<stbrp_coord>(std::lround(size.y) + glyphPadding);
+                rects.push_back(rect);
+            }
+        }
+        if (!rects.empty())
+            stbrp_pack_rects(&atlas.packer->context, rects.data(), static_cast<int>(rects.size()));
+
+        // glyphs are copied from the previous page; any that no longer fit are dropped
+        std::size_t const pitch = atlas.width;
+        float const widthScalar = 1.f / atlas.width;
+        float const heightScalar = 1.f / atlas.height;
+        atlas.droppedGlyphs = 0;
+        std::size_t next = 0;
+        for (grFont* font : context->fonts) {
+            if (font == nullptr)
+                continue;
+
+            std::size_t kept = 0;
+            for (std::size_t index = 0; index != font->glyphs.size(); ++index) {
+                if (!keep(*font, index))
+                    continue;
+
+                stbrp_rect const& rect = rects[next++];
+                if (rect.was_packed == 0) {
+                    ++atlas.droppedGlyphs;
+                    continue;
+                }
+
+                grGlyph glyph = font->glyphs[index];
+                int const x =
+                    static_cast<int>(std::lround(glyph.texCoord.minimum.x * previousWidth));
+                int const y =
+                    static_cast<int>(std::lround(glyph.texCoord.minimum.y * previousHeight));
+                int const width = rect.w - glyphPadding;
+                int const height = rect.h - glyphPadding;
+                for (int row = 0; row != height; ++row)
+                    std::memcpy(
+                        atlas.data + (rect.y + row) * pitch + rect.x,
+                        previous + (y + row) * previousPitch + x,
+                        static_cast<std::size_t>(width));
+
+                glyph.texCoord = {
+                    {rect.x * widthScalar, rect.y * heightScalar},
+                    {(rect.x + width) * widthScalar, (rect.y + height) * heightScalar}};
+                font->glyphs[kept] = glyph;
+                font->glyphUsed[kept] = font->glyphUsed[index];
+                ++kept;
+            }
+
+            font->glyphs.resize(kept);
+            font->glyphUsed.resize(kept);
+            grRebuildGlyphRanges(*font);
+            grFontBuildGlyphLookup(font);
+        }
+
+        grFree(previous);
+        grClearTextCache(context);
+    }
+
+    grFontAtlasStats grGetFontAtlasStats(grContext* context) {
+        grFontAtlasStats stats;
+        if (context == nullptr)
+            return stats;
+
+        grFontAtlas const& atlas = *context->fontAtlas;
+        if (atlas.data == nullptr)
+            return stats;
+
+        stats.width = atlas.width;
+        stats.height = atlas.height;
+        stats.droppedGlyphs = atlas.droppedGlyphs;
+        for (grFont const* font : context->fonts) {
+            if (font == nullptr)
+                continue;
+
+            stats.glyphCount += font->glyphs.size();
+            for (grGlyph const& glyph : font->glyphs) {
+                grVec2 const size = glyph.extent.size();
+                stats.usedTexels += static_cast<std::size_t>(std::lround(size.x)) *
+                    static_cast<std::size_t>(std::lround(size.y));
+            }
+        }
+        return stats;
+    }
+
     void grFontAtlasBindTexture(grContext* context, grTextureId textureId) {
         if (context == nullptr)
             return;
 
         context->fontAtlas->texture = textureId;
         context->fontAtlas->dirty = false;
+        context->fontAtlas->dirtyRects.clear();
     }
 
 } // namespace goober
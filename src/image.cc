@@ -0,0 +1,246 @@
+// goober - by Sean Middleditch
+// This is free and unencumbered software released into the public domain.
+// See LICENSE.md for more details.
+
+#include "goober/image.hh"
+
+#include <cstring>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+
+#include "stb_rect_pack.h"
+
+inline namespace goober {
+
+    struct grImagePacker {
+        stbrp_context context;
+        grArray<stbrp_node> nodes;
+    };
+
+    // gap left to the right of and below each image so filtering does not bleed
+    static constexpr int imagePadding = 1;
+
+    grImageAtlas::~grImageAtlas() {
+        for (grImageAtlasPage* page : pages) {
+            page->packer->~grImagePacker();
+            grFree(page->packer);
+            grFree(page->pixels);
+            page->~grImageAtlasPage();
+            grFree(page);
+        }
+
+        for (grAtlasImage& image : images)
+            grFree(image.pixels);
+    }
+
+    // starts an empty page holding only the solid white pixel at the origin, which untextured
+    // geometry merged into the page's commands samples, as it does with the font atlas
+    static void grResetImagePage(grImageAtlasPage& page) {
+        grImagePacker& packer = *page.packer;
+        int const size = static_cast<int>(page.size);
+
+        packer.nodes.resize(page.size);
+        stbrp_init_target(&packer.context, size, size, packer.nodes.data(), size);
+
+        std::memset(page.pixels, 0, std::size_t{page.size} * page.size * 4);
+
+        stbrp_rect pix = {};
+        pix.w = 1 + imagePadding;
+        pix.h = 1 + imagePadding;
+        stbrp_pack_rects(&packer.context, &pix, 1);
+        std::memset(page.pixels, 0xFF, 4);
+        page.dirty = true;
+    }
+
+    static grImageAtlasPage* grCreateImagePage(grImageAtlas& atlas) {
+        grImageAtlasPage* page = new (grAlloc(sizeof(grImageAtlasPage))) grImageAtlasPage;
+        page->size = atlas.pageSize;
+        page->pixels =
+            static_cast<unsigned char*>(grAlloc(std::size_t{page->size} * page->size * 4));
+        page->packer = new (grAlloc(sizeof(grImagePacker))) grImagePacker;
+        grResetImagePage(*page);
+
+        atlas.pages.push_back(page);
+        return page;
+    }
+
+    // copies the image into the page if the page's packer still has room
+    static bool grPackImage(grImageAtlas& atlas, int pageIndex, grAtlasImage& image) {
+        grImageAtlasPage& page = *atlas.pages[pageIndex];
+
+        stbrp_rect rect = {};
+        rect.w = static_cast<stbrp_coord>(image.width + imagePadding);
+        rect.h = static_cast<stbrp_coord>(image.height + imagePadding);
+        if (stbrp_pack_rects(&page.packer->context, &rect, 1) == 0)
+            return false;
+
+        std::size_t const rowBytes = static_cast<std::size_t>(image.width) * 4;
+        std::size_t const pitch = std::size_t{page.size} * 4;
+        unsigned char* out = page.pixels + rect.y * pitch + rect.x * std::size_t{4};
+        for (int row = 0; row != image.height; ++row, out += pitch)
+            std::memcpy(out, image.pixels + row * rowBytes, rowBytes);
+
+        float const scale = 1.f / static_cast<float>(page.size);
+        image.page = pageIndex;
+        image.texCoord = {
+            {rect.x * scale, rect.y * scale},
+            {(rect.x + image.width) * scale, (rect.y + image.height) * scale}};
+        page.dirty = true;
+        return true;
+    }
+
+    static bool grPlaceImage(
+        grImageAtlas& atlas,
+        grAtlasImage& image,
+        std::uint64_t frame,
+        bool evict) {
+        int const pageCount = static_cast<int>(atlas.pages.size());
+        for (int page = 0; page != pageCount; ++page) {
+            if (grPackImage(atlas, page, image))
+                return true;
+        }
+
+        if (atlas.pages.size() < atlas.maxPages) {
+            grCreateImagePage(atlas);
+            return grPackImage(atlas, pageCount, image);
+        }
+
+        if (!evict || pageCount == 0)
+            return false;
+
+        // recycle the page drawn least recently, unless every page was drawn this frame
+        grArray<std::uint64_t> pageUsed;
+        pageUsed.resize(atlas.pages.size());
+        for (std::uint64_t& used : pageUsed)
+            used = 0;
+        for (grAtlasImage const& other : atlas.images) {
+            if (other.page >= 0 && other.lastUsed > pageUsed[other.page])
+                pageUsed[other.page] = other.lastUsed;
+        }
+
+        int oldest = 0;
+        for (int page = 1; page != pageCount; ++page) {
+            if (pageUsed[page] < pageUsed[oldest])
+                oldest = page;
+        }
+        if (pageUsed[oldest] > frame)
+            return false;
+
+        for (grAtlasImage& other : atlas.images) {
+            if (other.page == oldest)
+                other.page = -1;
+        }
+
+        grResetImagePage(*atlas.pages[oldest]);
+
+        return grPackImage(atlas, oldest, image);
+    }
+
+    static grAtlasImage* grGetAtlasImage(grImageAtlas* atlas, grImageId imageId) {
+        if (atlas == nullptr || imageId == 0 || imageId > atlas->images.size())
+            return nullptr;
+
+        grAtlasImage& image = atlas->images[imageId - 1];
+        return image.pixels != nullptr ? &image : nullptr;
+    }
+
+    grResult<grImageId> grAddImage(
+        grContext* context,
+        unsigned char const* rgba,
+        int width,
+        int height) {
+        if (context == nullptr || rgba == nullptr)
+            return grStatus::NullArgument;
+        if (context->imageAtlas == nullptr)
+            return grStatus::Unsupported;
+        if (width <= 0 || height <= 0)
+            return grStatus::Empty;
+
+        grImageAtlas& atlas = *context->imageAtlas;
+        if (width + imagePadding > static_cast<int>(atlas.pageSize) ||
+            height + imagePadding > static_cast<int>(atlas.pageSize))
+            return grStatus::Unsupported;
+
+        grImageId id = 0;
+        for (std::size_t index = 0; index != atlas.images.size() && id == 0; ++index) {
+            if (atlas.images[index].pixels == nullptr)
+                id = index + 1;
+        }
+        if (id == 0) {
+            atlas.images.push_back({});
+            id = atlas.images.size();
+        }
+
+        std::size_t const bytes = static_cast<std::size_t>(width) * height * 4;
+        grAtlasImage& image = atlas.images[id - 1];
+        image = {};
+        image.pixels = static_cast<unsigned char*>(grAlloc(bytes));
+        image.width = width;
+        image.height = height;
+        std::memcpy(image.pixels, rgba, bytes);
+
+        // packs now when there is room; otherwise on first use
+        grPlaceImage(atlas, image, context->frame, false);
+        return id;
+    }
+
+    grStatus grRemoveImage(grContext* context, grImageId imageId) {
+        if (context == nullptr)
+            return grStatus::NullArgument;
+
+        grAtlasImage* image = grGetAtlasImage(context->imageAtlas, imageId);
+        if (image == nullptr)
+            return grStatus::InvalidId;
+
+        grFree(image->pixels);
+        *image = {};
+        return grStatus::Ok;
+    }
+
+    grResult<grImageRegion> grResolveImage(grContext* context, grImageId imageId) {
+        if (context == nullptr)
+            return grStatus::NullArgument;
+        if (context->parent != nullptr)
+            return grStatus::Unsupported;
+
+        grAtlasImage* image = grGetAtlasImage(context->imageAtlas, imageId);
+        if (image == nullptr)
+            return grStatus::InvalidId;
+
+        image->lastUsed = context->frame + 1;
+        if (image->page < 0 && !grPlaceImage(*context->imageAtlas, *image, context->frame, true))
+            return grStatus::BadAlloc;
+
+        // a page the backend has yet to upload has no texture, and drawing without one shows a
+        // solid quad; the image is skipped and another frame requested to draw it once bound
+        grImageAtlasPage const& page = *context->imageAtlas->pages[image->page];
+        if (page.texture == 0) {
+            grRequestAnimation(context, 0.f);
+            return grStatus::Empty;
+        }
+
+        return grImageRegion{page.texture, image->texCoord};
+    }
+
+    grImageAtlasPage const* grGetImageAtlasPageIfDirty(grContext* context, unsigned int page) {
+        if (context == nullptr || context->imageAtlas == nullptr)
+            return nullptr;
+        if (page >= context->imageAtlas->pages.size())
+            return nullptr;
+
+        grImageAtlasPage const* atlasPage = context->imageAtlas->pages[page];
+        return atlasPage->dirty ? atlasPage : nullptr;
+    }
+
+    void grImageAtlasBindTexture(grContext* context, unsigned int page, grTextureId textureId) {
+        if (context == nullptr || context->imageAtlas == nullptr)
+            return;
+        if (page >= context->imageAtlas->pages.size())
+            return;
+
+        context->imageAtlas->pages[page]->texture = textureId;
+        context->imageAtlas->pages[page]->dirty = false;
+    }
+
+} // namespace goober
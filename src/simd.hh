@@ -0,0 +1,22 @@
+// goober - by Sean Middleditch
+// This is free and unencumbered software released into the public domain.
+// See LICENSE.md for more details.
+
+#if !defined(GOOBER_SIMD_HH_)
+#define GOOBER_SIMD_HH_
+#pragma once
+
+// Selects the vector instruction set used by goober's internal kernels.
+// Define GOOBER_NO_SIMD to force the scalar fallbacks.
+
+#if !defined(GOOBER_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GOOBER_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define GOOBER_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+#endif // defined(GOOBER_SIMD_HH_)
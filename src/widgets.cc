@@ -5,6 +5,7 @@
 #include "goober/core.hh"
 #include "goober/draw.hh"
 #include "goober/font.hh"
+#include "goober/image.hh"
 
 inline namespace goober {
 
@@ -15,7 +16,17 @@ inline namespace goober {
 
         grId const id = grGetId(context, label);
 
-        grVec2 const labelSize = grFontMeasureText(context, 0, label);
+        // builder contexts have no text cache, so they lay the label out for this frame only
+        grCachedText const* const cached = grFontGetCachedText(context, 0, label);
+        grTextRun* run = nullptr;
+        if (cached == nullptr) {
+            if (context->textRun.get() == nullptr)
+                context->textRun.reset(new (grAlloc(sizeof(grTextRun))) grTextRun);
+            run = context->textRun.get();
+            grFontLayoutText(grGetFont(context, 0), label, *run);
+        }
+
+        grVec2 const labelSize = cached != nullptr ? cached->size : run->size;
         grRect const aabb(pos, pos + labelSize + grVec2(8, 8));
 
         bool const over = grIsMouseOver(context, aabb);
@@ -35,12 +46,11 @@ inline namespace goober {
         port->draw->drawRect(
             {{pos.x + 2, pos.y + 2}, {aabb.maximum.x - 2, aabb.maximum.y - 2}},
             color);
-        port->draw->drawText(
-            grGetFont(context, 0),
-            context->fontAtlas->texture,
-            {pos.x + 4, pos.y + 4},
-            rgba,
-            label);
+        grVec2 const labelPos{pos.x + 4, pos.y + 4};
+        if (cached != nullptr)
+            port->draw->drawCachedText(context->fontAtlas->texture, labelPos, rgba, *cached);
+        else
+            port->draw->drawTextRun(context->fontAtlas->texture, labelPos, rgba, *run);
 
         bool const clicked = over && active && grIsMouseReleased(context, grButtonMask::Left);
         if (clicked)
@@ -62,6 +72,18 @@ inline namespace goober {
         draw->drawRect(textureId, pos, texCoord, rgba);
     }
 
+    void grImage(grContext* context, grImageId imageId, grRect pos, grColor rgba) {
+        grDrawList* draw = grCurrentDrawList(context);
+        if (draw == nullptr)
+            return;
+
+        grResult<grImageRegion> const region = grResolveImage(context, imageId);
+        if (!region)
+            return;
+
+        draw->drawRect(region.value.texture, pos, region.value.texCoord, rgba);
+    }
+
     void grText(grContext* context, grStringView text, grVec2 pos, grColor rgba) {
         grDrawList* draw = grCurrentDrawList(context);
         if (draw == nullptr)
@@ -71,7 +93,11 @@ inline namespace goober {
         if (font == nullptr)
             return;
 
-        draw->drawText(font, context->fontAtlas->texture, pos, rgba, text);
+        grCachedText const* const cached = grFontGetCachedText(context, 0, text);
+        if (cached != nullptr)
+            draw->drawCachedText(context->fontAtlas->texture, pos, rgba, *cached);
+        else
+            draw->drawText(font, context->fontAtlas->texture, pos, rgba, text);
     }
 
 } // namespace goober
@@ -0,0 +1,108 @@
+// goober - by Sean Middleditch
+// This is free and unencumbered software released into the public domain.
+// See LICENSE.md for more details.
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+#include "goober/draw.hh"
+#include "goober/font.hh"
+
+// Run with: goober_test "[benchmark]"
+// Each benchmark emits quadCount quads per run.
+
+static constexpr int quadCount = 4096;
+
+// per-vertex push_back, as draw lists were originally built
+static void drawRectScalar(grDrawList& draw, grRect rect, grColor color) {
+    auto const vertex = static_cast<grDrawList::Offset>(draw.vertices.size());
+
+    if (draw.commands.empty())
+        draw.commands.push_back({});
+
+    draw.vertices.push_back({rect.minimum, {}, color});
+    draw.vertices.push_back({{rect.maximum.x, rect.minimum.y}, {}, color});
+    draw.vertices.push_back({rect.maximum, {}, color});
+    draw.vertices.push_back({{rect.minimum.x, rect.maximum.y}, {}, color});
+
+    draw.indices.push_back(vertex + 0);
+    draw.indices.push_back(vertex + 1);
+    draw.indices.push_back(vertex + 2);
+    draw.indices.push_back(vertex + 2);
+    draw.indices.push_back(vertex + 3);
+    draw.indices.push_back(vertex + 0);
+
+    draw.commands.back().indexCount += 6;
+}
+
+TEST_CASE("quad generation", "[.][benchmark]") {
+    grDrawList draw;
+
+    BENCHMARK("scalar push_back rects") {
+        draw.reset();
+        for (int index = 0; index != quadCount; ++index) {
+            float const x = static_cast<float>(index % 64);
+            float const y = static_cast<float>(index / 64);
+            drawRectScalar(draw, {x, y, x + 1, y + 1}, grColors::white);
+        }
+        return draw.vertices.size();
+    };
+
+    BENCHMARK("drawRect") {
+        draw.reset();
+        for (int index = 0; index != quadCount; ++index) {
+            float const x = static_cast<float>(index % 64);
+            float const y = static_cast<float>(index / 64);
+            draw.drawRect({x, y, x + 1, y + 1}, grColors::white);
+        }
+        return draw.vertices.size();
+    };
+
+    auto [result, ctx] = grCreateContext();
+    auto [fontResult, fontId] = grCreateDefaultFont(ctx);
+    grGetFontAtlasIfDirtyAlpha8(ctx);
+    grFont const* font = grGetFont(ctx, fontId);
+
+    char text[quadCount + 1] = {};
+    for (int index = 0; index != quadCount; ++index)
+        text[index] = static_cast<char>('a' + index % 26);
+    grStringView const view(text);
+
+    BENCHMARK("drawText glyphs") {
+        draw.reset();
+        draw.drawText(font, 1, {0, 0}, grColors::white, view);
+        return draw.vertices.size();
+    };
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("heatmap grid", "[.][benchmark]") {
+    constexpr int side = 256;
+
+    grArray<grRect> cells;
+    grArray<grColor> colors;
+    for (int y = 0; y != side; ++y) {
+        for (int x = 0; x != side; ++x) {
+            float const fx = static_cast<float>(x);
+            float const fy = static_cast<float>(y);
+            cells.push_back({fx, fy, fx + 1, fy + 1});
+            colors.push_back(
+                {static_cast<grColor::Component>(x), static_cast<grColor::Component>(y), 0});
+        }
+    }
+
+    grDrawList draw;
+
+    BENCHMARK("drawRect per cell") {
+        draw.reset();
+        for (int index = 0; index != side * side; ++index)
+            draw.drawRect(cells[index], colors[index]);
+        return draw.vertices.size();
+    };
+
+    BENCHMARK("drawRects") {
+        draw.reset();
+        draw.drawRects(cells.data(), colors.data(), side * side);
+        return draw.vertices.size();
+    };
+}
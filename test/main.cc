@@ -3,4 +3,5 @@
 // See LICENSE.md for more details.
 
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch.hpp"
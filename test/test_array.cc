@@ -77,3 +77,46 @@ TEST_CASE("grArray", "[array]") {
         REQUIRE(test.capacity() == 0);
     }
 }
+
+TEST_CASE("grArray attached storage", "[array]") {
+    std::size_t storage[16] = {};
+
+    SECTION("writes into storage") {
+        grArray<std::size_t> test;
+        test.attach(storage, 16);
+        REQUIRE(test.borrowed());
+        REQUIRE(test.capacity() == 16);
+
+        for (std::size_t index = 0; index != 16; ++index)
+            test.push_back(index);
+
+        REQUIRE(test.data() == storage);
+        for (std::size_t index = 0; index != 16; ++index)
+            REQUIRE(storage[index] == index);
+    }
+
+    SECTION("grows into owned memory") {
+        grArray<std::size_t> test;
+        test.attach(storage, 16);
+
+        for (std::size_t index = 0; index != 100; ++index)
+            test.push_back(index);
+
+        REQUIRE_FALSE(test.borrowed());
+        REQUIRE(test.data() != storage);
+        for (std::size_t index = 0; index != 100; ++index)
+            REQUIRE(test[index] == index);
+    }
+
+    SECTION("detach") {
+        grArray<std::size_t> test;
+        test.attach(storage, 16);
+        test.push_back(7);
+
+        test.detach();
+        REQUIRE_FALSE(test.borrowed());
+        REQUIRE(test.empty());
+        REQUIRE(test.capacity() == 0);
+        REQUIRE(storage[0] == 7);
+    }
+}
@@ -4,6 +4,9 @@
 
 #include "catch.hpp"
 #include "goober/core.hh"
+#include "goober/draw.hh"
+#include "goober/font.hh"
+#include "goober/image.hh"
 
 TEST_CASE("core initialization", "[core]") {
     auto [result, ctx] = grCreateContext();
@@ -16,14 +19,17 @@ TEST_CASE("core initialization", "[core]") {
 TEST_CASE("fnv1a", "[core][hash]") {
     static constexpr char test[] = "this is test input";
     static constexpr char empty[] = "";
+    static constexpr char utf8[] = "\xC3\xA9";
 
     SECTION("runtime") {
-        CHECK(grHashFnv1a(test, sizeof(test) - 1) == 0x77e875b1c7b6a32d);
+        CHECK(grHashFnv1a(test, sizeof(test) - 1) == 0xa18b9b7c39eb1f0d);
         CHECK(grHashFnv1a(empty, sizeof(empty) - 1) == 0xcbf29ce484222325);
+        CHECK(grHashFnv1a(utf8, sizeof(utf8) - 1) == 0x0ac21707b7181e01);
+        CHECK(grHashFnv1a("ab") != grHashFnv1a("ba"));
     }
 
     static_assert(
-        grHashFnv1a(test, sizeof(test) - 1) == 0x77e875b1c7b6a32d,
+        grHashFnv1a(test, sizeof(test) - 1) == 0xa18b9b7c39eb1f0d,
         "grHashFnv1a(test) result incorrect");
     static_assert(
         grHashFnv1a(empty, sizeof(empty) - 1) == 0xcbf29ce484222325,
@@ -62,3 +68,210 @@ TEST_CASE("grIsContained", "[core][math]") {
         CHECK_FALSE(grIsContained(aabb, {5, 30}));
     }
 }
+
+TEST_CASE("draw data snapshots", "[core][draw]") {
+    auto [result, ctx] = grCreateContext();
+
+    CHECK(grGetDrawData(ctx) == nullptr);
+
+    grBeginFrame(ctx, 0.f);
+    grBeginPortal(ctx, "test");
+    grCurrentDrawList(ctx)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+    grEndPortal(ctx);
+    grEndFrame(ctx);
+
+    CHECK(ctx->portals[0]->draw->vertices.empty());
+
+    grDrawData const* first = grGetDrawData(ctx);
+    REQUIRE(first != nullptr);
+    REQUIRE(first->lists.size() == 1);
+    CHECK(first->lists[0].vertices.size() == 4);
+    CHECK(grGetDrawData(ctx) == first);
+
+    for (int frame = 0; frame != 3; ++frame) {
+        grBeginFrame(ctx, 0.f);
+        grBeginPortal(ctx, "test");
+        grCurrentDrawList(ctx)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+        grCurrentDrawList(ctx)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+        grEndPortal(ctx);
+        grEndFrame(ctx);
+
+        // the snapshot held by the consumer is untouched by later frames
+        CHECK(first->lists[0].vertices.size() == 4);
+    }
+
+    grDrawData const* latest = grGetDrawData(ctx);
+    REQUIRE(latest != nullptr);
+    CHECK(latest != first);
+    CHECK(latest->frame == first->frame + 3);
+    CHECK(latest->lists[0].vertices.size() == 8);
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("draw data damage", "[core][draw]") {
+    auto [result, ctx] = grCreateContext();
+
+    auto const build = [ctx = ctx](bool caret) {
+        grBeginFrame(ctx, 0.f);
+        grBeginPortal(ctx, "test");
+        grDrawList& draw = *grCurrentDrawList(ctx);
+        draw.drawRect({{0, 0}, {100, 20}}, grColors::grey);
+        if (caret)
+            draw.drawRect({{40.5f, 2}, {41.5f, 18}}, grColors::white);
+        draw.drawRect({{0, 50}, {100, 70}}, grColors::grey);
+        grEndPortal(ctx);
+        grEndFrame(ctx);
+    };
+    auto const frame = [ctx = ctx, build](bool caret) {
+        build(caret);
+        return grGetDrawData(ctx);
+    };
+
+    grDrawData const* data = frame(false);
+    CHECK(data->damageKnown);
+    REQUIRE(data->damage.size() == 1);
+    CHECK(data->damage[0].minimum == grVec2{0, 0});
+    CHECK(data->damage[0].maximum == grVec2{100, 70});
+
+    data = frame(false);
+    CHECK(data->damage.empty());
+
+    data = frame(true);
+    REQUIRE(data->damage.size() == 1);
+    CHECK(data->damage[0].minimum == grVec2{40, 2});
+    CHECK(data->damage[0].maximum == grVec2{42, 18});
+
+    data = frame(false);
+    REQUIRE(data->damage.size() == 1);
+    CHECK(data->damage[0].minimum == grVec2{40, 2});
+
+    SECTION("skipped frames carry their damage") {
+        // the caret appears in a frame the consumer never takes
+        build(true);
+        data = frame(true);
+        CHECK(data->frame == 6);
+        REQUIRE(data->damage.size() == 1);
+        CHECK(data->damage[0].minimum == grVec2{40, 2});
+        CHECK(data->damage[0].maximum == grVec2{42, 18});
+
+        data = frame(true);
+        CHECK(data->damage.empty());
+    }
+
+    SECTION("merging keeps rects within the limit") {
+        grArray<grRect> damage;
+        damage.push_back({{0, 0}, {10, 10}});
+        damage.push_back({{5, 5}, {20, 20}});
+        damage.push_back({{100, 0}, {110, 10}});
+        damage.push_back({{120, 0}, {130, 10}});
+
+        grMergeDamage(damage, 2);
+        REQUIRE(damage.size() == 2);
+        CHECK(damage[0].minimum == grVec2{0, 0});
+        CHECK(damage[0].maximum == grVec2{20, 20});
+        CHECK(damage[1].minimum == grVec2{100, 0});
+        CHECK(damage[1].maximum == grVec2{130, 10});
+    }
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("frame status", "[core]") {
+    auto [result, ctx] = grCreateContext();
+    grFrameStatus status;
+
+    grBeginFrame(ctx, 0.f);
+    grBeginPortal(ctx, "test");
+    grCurrentDrawList(ctx)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+    grEndPortal(ctx);
+    grEndFrame(ctx, &status);
+    CHECK(status.changed);
+    CHECK_FALSE(status.animating);
+    CHECK(status.nextWakeup < 0.f);
+
+    grBeginFrame(ctx, 0.f);
+    grBeginPortal(ctx, "test");
+    grCurrentDrawList(ctx)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+    grRequestAnimation(ctx, 0.5f);
+    grRequestAnimation(ctx, 0.25f);
+    grEndPortal(ctx);
+    grEndFrame(ctx, &status);
+    CHECK_FALSE(status.changed);
+    CHECK(status.animating);
+    CHECK(status.nextWakeup == 0.25f);
+
+    grBeginFrame(ctx, 0.f);
+    grEndFrame(ctx, &status);
+    CHECK(status.changed);
+    CHECK_FALSE(status.animating);
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("portal builders", "[core][portal]") {
+    auto [result, ctx] = grCreateContext();
+    ctx->mousePos = {5, 5};
+
+    grBeginFrame(ctx, 0.f);
+
+    auto [resultA, builderA] = grCreatePortalBuilder(ctx, "inspector");
+    auto [resultB, builderB] = grCreatePortalBuilder(ctx, "outline");
+    REQUIRE(resultA == grStatus::Ok);
+    REQUIRE(resultB == grStatus::Ok);
+    REQUIRE(ctx->portals.size() == 2);
+
+    grContext* viewA = &builderA->context;
+    grContext* viewB = &builderB->context;
+
+    CHECK(grCurrentPortal(viewA) == ctx->portals[0]);
+    CHECK(grCurrentPortal(viewB) == ctx->portals[1]);
+    CHECK(grIsMouseOver(viewA, {0, 0, 10, 10}));
+    CHECK(grBeginPortal(viewA, "nested").status == grStatus::Unsupported);
+
+    // a portal has one writer at a time
+    CHECK(grCreatePortalBuilder(ctx, "inspector").status == grStatus::Unsupported);
+    CHECK(grBeginPortal(ctx, "outline").status == grStatus::Unsupported);
+    REQUIRE(grBeginPortal(ctx, "main").status == grStatus::Ok);
+    CHECK(grCreatePortalBuilder(ctx, "main").status == grStatus::Unsupported);
+    grEndPortal(ctx);
+    CHECK(ctx->builders.size() == 2);
+
+    unsigned char const pixel[4] = {};
+    grImageId const image = grAddImage(ctx, pixel, 1, 1).value;
+    CHECK(grResolveImage(viewA, image).status == grStatus::Unsupported);
+
+    CHECK(grPushId(viewA, 7) == grStatus::Ok);
+    CHECK(ctx->portals[0]->idStack.size() == 1);
+    CHECK(ctx->portals[1]->idStack.empty());
+    CHECK(grGetId(viewA, "x") != grGetId(viewB, "x"));
+
+    grCurrentDrawList(viewA)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+    grCurrentDrawList(viewB)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+    grCurrentDrawList(viewB)->drawRect({{0, 0}, {10, 10}}, grColors::white);
+
+    viewB->activeIdNext = 42;
+
+    // dynamic glyph lookups would modify the fonts the builders share
+    CHECK(grSetFontAtlasDynamic(ctx, true, 64) == grStatus::Unsupported);
+
+    grEndFrame(ctx);
+    CHECK(ctx->builders.empty());
+
+    grDrawData const* data = grGetDrawData(ctx);
+    REQUIRE(data != nullptr);
+    REQUIRE(data->lists.size() == 3);
+    CHECK(data->lists[0].vertices.size() == 4);
+    CHECK(data->lists[1].vertices.size() == 8);
+
+    grBeginFrame(ctx, 0.f);
+    CHECK(ctx->activeId == 42);
+
+    REQUIRE(grSetFontAtlasDynamic(ctx, true, 64) == grStatus::Ok);
+    CHECK(grCreatePortalBuilder(ctx, "inspector").status == grStatus::Unsupported);
+    CHECK(grSetFontAtlasDynamic(ctx, false, 0) == grStatus::Ok);
+    CHECK(grCreatePortalBuilder(ctx, "inspector").status == grStatus::Ok);
+    grEndFrame(ctx);
+
+    grDestroyContext(ctx);
+}
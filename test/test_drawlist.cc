@@ -4,6 +4,9 @@
 
 #include "catch.hpp"
 #include "goober/draw.hh"
+#include "goober/font.hh"
+
+#include <cmath>
 
 TEST_CASE("draw rect", "[draw]") {
     grDrawList draw;
@@ -14,3 +17,748 @@ TEST_CASE("draw rect", "[draw]") {
     REQUIRE(draw.indices.size() == 6);
     REQUIRE(draw.commands.size() == 1);
 }
+
+TEST_CASE("draw into caller blocks", "[draw]") {
+    struct Blocks {
+        grDrawList::Vertex vertices[2][8];
+        grDrawList::Index indices[2][12];
+        int requests = 0;
+        std::size_t consumedIndices = 0;
+    } blocks;
+
+    grDrawList draw;
+    draw.blockUserData = &blocks;
+    draw.blockCallback = [](void* userData, grDrawList const& draw) {
+        auto& blocks = *static_cast<Blocks*>(userData);
+        for (grDrawList::Command const& cmd : draw.commands)
+            blocks.consumedIndices += cmd.indexCount;
+
+        int const which = blocks.requests++ % 2;
+        return grDrawList::Block{blocks.vertices[which], blocks.indices[which], 8, 12};
+    };
+
+    draw.drawRect({{0, 0}, {10, 10}}, grColors::white);
+    REQUIRE(blocks.requests == 1);
+    REQUIRE(draw.vertices.data() == blocks.vertices[0]);
+    REQUIRE(draw.indices.data() == blocks.indices[0]);
+    CHECK(blocks.vertices[0][2].pos == grVec2{10, 10});
+
+    draw.drawRect({{10, 10}, {20, 20}}, grColors::white);
+    REQUIRE(blocks.requests == 1);
+    REQUIRE(draw.vertices.size() == 8);
+
+    draw.drawRect({{20, 20}, {30, 30}}, grColors::white);
+    REQUIRE(blocks.requests == 2);
+    CHECK(blocks.consumedIndices == 12);
+    REQUIRE(draw.vertices.data() == blocks.vertices[1]);
+    REQUIRE(draw.vertices.size() == 4);
+    REQUIRE(draw.commands.size() == 1);
+    CHECK(draw.commands[0].indexStart == 0);
+    CHECK(blocks.indices[1][2] == 2);
+    CHECK(blocks.vertices[1][0].pos == grVec2{20, 20});
+
+    draw.reset();
+    REQUIRE(draw.vertices.empty());
+    REQUIRE_FALSE(draw.vertices.borrowed());
+}
+
+TEST_CASE("declined caller blocks", "[draw]") {
+    int requests = 0;
+
+    grDrawList draw;
+    draw.blockUserData = &requests;
+    draw.blockCallback = [](void* userData, grDrawList const&) {
+        ++*static_cast<int*>(userData);
+        return grDrawList::Block{};
+    };
+
+    // an empty block hands the rest of the frame to the list's own memory
+    for (int index = 0; index != 1000; ++index)
+        draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    CHECK(requests == 1);
+    CHECK(draw.vertices.size() == 4000);
+    CHECK_FALSE(draw.vertices.borrowed());
+
+    draw.reset();
+    draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    CHECK(requests == 2);
+}
+
+TEST_CASE("caller blocks beyond the index range", "[draw]") {
+    struct Blocks {
+        grArray<grDrawList::Vertex> vertices;
+        grArray<grDrawList::Index> indices;
+        int requests = 0;
+    } blocks;
+    blocks.vertices.resize(70000);
+    blocks.indices.resize(120000);
+
+    grDrawList draw;
+    draw.blockUserData = &blocks;
+    draw.blockCallback = [](void* userData, grDrawList const&) {
+        auto& blocks = *static_cast<Blocks*>(userData);
+        ++blocks.requests;
+        return grDrawList::Block{blocks.vertices.data(), blocks.indices.data(), 70000, 120000};
+    };
+
+    // 16-bit indices reach only the first 65536 vertices of the block
+    for (int index = 0; index != 16385; ++index)
+        draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    CHECK(blocks.requests == 2);
+    CHECK(draw.vertices.size() == 4);
+}
+
+TEST_CASE("draw list streaming flush", "[draw]") {
+    struct Stream {
+        int flushes = 0;
+        std::size_t vertices = 0;
+        std::size_t indices = 0;
+    } stream;
+
+    grDrawList draw;
+    draw.chunkVertices = 8;
+    draw.chunkIndices = 12;
+    draw.flushUserData = &stream;
+    draw.flushCallback = [](void* userData, grDrawList const& draw) {
+        auto& stream = *static_cast<Stream*>(userData);
+        ++stream.flushes;
+        stream.vertices += draw.vertices.size();
+        for (grDrawList::Command const& cmd : draw.commands)
+            stream.indices += cmd.indexCount;
+    };
+
+    for (int index = 0; index != 5; ++index)
+        draw.drawRect({{0, 0}, {10, 10}}, grColors::white);
+
+    CHECK(stream.flushes == 2);
+    CHECK(draw.vertices.size() == 4);
+    CHECK(draw.commands.size() == 1);
+    CHECK(draw.commands[0].indexStart == 0);
+
+    draw.flush();
+    CHECK(stream.flushes == 3);
+    CHECK(stream.vertices == 20);
+    CHECK(stream.indices == 30);
+    CHECK(draw.vertices.empty());
+
+    draw.flush();
+    CHECK(stream.flushes == 3);
+}
+
+TEST_CASE("streaming chunks beyond the index range", "[draw]") {
+    int flushes = 0;
+
+    grDrawList draw;
+    draw.chunkVertices = 100000;
+    draw.flushUserData = &flushes;
+    draw.flushCallback = [](void* userData, grDrawList const&) {
+        ++*static_cast<int*>(userData);
+    };
+
+    // 16-bit indices reach only the first 65536 vertices of the chunk
+    for (int index = 0; index != 16385; ++index)
+        draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    CHECK(flushes == 1);
+    CHECK(draw.vertices.size() == 4);
+}
+
+TEST_CASE("draw rect corners", "[draw]") {
+    grDrawList draw;
+
+    draw.drawRect(7, {{1, 2}, {3, 4}}, {{0.25f, 0.5f}, {0.75f, 1.f}}, grColors::red);
+
+    REQUIRE(draw.vertices.size() == 4);
+    CHECK(draw.vertices[0].pos == grVec2{1, 2});
+    CHECK(draw.vertices[0].uv == grVec2{0.25f, 0.5f});
+    CHECK(draw.vertices[1].pos == grVec2{3, 2});
+    CHECK(draw.vertices[1].uv == grVec2{0.75f, 0.5f});
+    CHECK(draw.vertices[2].pos == grVec2{3, 4});
+    CHECK(draw.vertices[2].uv == grVec2{0.75f, 1.f});
+    CHECK(draw.vertices[3].pos == grVec2{1, 4});
+    CHECK(draw.vertices[3].uv == grVec2{0.25f, 1.f});
+    for (grDrawList::Vertex const& vertex : draw.vertices)
+        CHECK(vertex.rgba.r == 255);
+
+    REQUIRE(draw.commands.size() == 1);
+    CHECK(draw.commands[0].textureId == 7);
+}
+
+TEST_CASE("draw text", "[draw][font]") {
+    auto [result, ctx] = grCreateContext();
+    auto [fontResult, fontId] = grCreateDefaultFont(ctx);
+    grGetFontAtlasIfDirtyAlpha8(ctx);
+    grFont const* font = grGetFont(ctx, fontId);
+
+    // long enough to cross several glyph batches
+    char text[200] = {};
+    for (int index = 0; index != 199; ++index)
+        text[index] = static_cast<char>('!' + index % 90);
+
+    grDrawList draw;
+    draw.drawText(font, 1, {10, 20}, grColors::white, text);
+
+    REQUIRE(draw.vertices.size() == 199 * 4);
+    REQUIRE(draw.indices.size() == 199 * 6);
+
+    float pen = 10;
+    for (int index = 0; index != 199; ++index) {
+        grGlyph const* glyph = grFontGetGlyph(font, text[index]);
+        REQUIRE(glyph != nullptr);
+
+        grVec2 const expected = glyph->extent.minimum + grVec2{pen, 20 + font->lineHeight};
+        CHECK(draw.vertices[index * 4].pos == expected);
+        CHECK(draw.vertices[index * 4 + 2].uv == glyph->texCoord.maximum);
+        pen += glyph->xAdvance;
+    }
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("draw rect batches", "[draw]") {
+    grRect rects[3] = {{0, 0, 1, 1}, {1, 1, 2, 2}, {2, 2, 3, 3}};
+    grColor colors[3] = {grColors::red, grColors::green, grColors::blue};
+
+    SECTION("rects") {
+        grDrawList draw;
+        draw.drawRects(rects, colors, 3);
+
+        REQUIRE(draw.vertices.size() == 12);
+        REQUIRE(draw.indices.size() == 18);
+        REQUIRE(draw.commands.size() == 1);
+        CHECK(draw.commands[0].indexCount == 18);
+        CHECK(draw.vertices[4].pos == grVec2{1, 1});
+        CHECK(draw.vertices[10].pos == grVec2{3, 3});
+        CHECK(draw.vertices[8].rgba.b == 255);
+        CHECK(draw.indices[6] == 4);
+        CHECK(draw.indices[17] == 8);
+    }
+
+    SECTION("images") {
+        grRect texCoords[3] = {{0, 0, 0.5f, 0.5f}, {0.5f, 0, 1, 0.5f}, {0, 0.5f, 0.5f, 1}};
+
+        grDrawList draw;
+        draw.drawImages(5, rects, texCoords, colors, 3);
+
+        REQUIRE(draw.vertices.size() == 12);
+        REQUIRE(draw.commands.size() == 1);
+        CHECK(draw.commands[0].textureId == 5);
+        CHECK(draw.vertices[5].uv == grVec2{1, 0});
+        CHECK(draw.vertices[11].uv == grVec2{0, 1});
+    }
+
+    SECTION("spanning chunks") {
+        int flushes = 0;
+
+        grDrawList draw;
+        draw.chunkVertices = 8;
+        draw.flushUserData = &flushes;
+        draw.flushCallback = [](void* userData, grDrawList const&) {
+            ++*static_cast<int*>(userData);
+        };
+        draw.drawRects(rects, colors, 3);
+
+        CHECK(flushes == 1);
+        CHECK(draw.vertices.size() == 4);
+        CHECK(draw.vertices[0].pos == grVec2{2, 2});
+    }
+}
+
+TEST_CASE("draw list transforms", "[draw]") {
+    grDrawList draw;
+    for (int index = 0; index != 7; ++index) {
+        float const x = static_cast<float>(index * 10);
+        draw.drawRect(3, {x, 0, x + 10, 10}, {0, 0, 1, 1}, grColor(1, 2, 3, 4));
+    }
+
+    auto const callback = [](void*, grDrawList const&, grDrawList::Command const&) {};
+    draw.drawCallback(callback, nullptr, {{0, 0}, {10, 10}});
+    auto const bounds = [&] {
+        for (grDrawList::Command const& cmd : draw.commands) {
+            if (cmd.callback != nullptr)
+                return cmd.callbackBounds;
+        }
+        return grRect{};
+    };
+
+    SECTION("translate") {
+        draw.translate({5, -2}, 2);
+        CHECK(bounds().minimum == grVec2{5, -2});
+        CHECK(bounds().maximum == grVec2{15, 8});
+
+        // a callback moves with transforms from its own position on, not later ones
+        draw.translate({100, 0}, 28);
+        CHECK(bounds().minimum == grVec2{105, -2});
+        draw.translate({100, 0}, 29);
+        CHECK(bounds().minimum == grVec2{105, -2});
+
+        CHECK(draw.vertices[0].pos == grVec2{0, 0});
+        CHECK(draw.vertices[1].pos == grVec2{10, 0});
+        CHECK(draw.vertices[2].pos == grVec2{15, 8});
+        CHECK(draw.vertices[3].pos == grVec2{5, 8});
+        CHECK(draw.vertices[27].pos == grVec2{65, 8});
+        for (int index = 4; index != 28; index += 4)
+            CHECK(draw.vertices[index].pos == grVec2{index * 2.5f + 5, -2});
+    }
+
+    SECTION("scale") {
+        draw.scale({2, 0.5f}, {10, 10});
+        CHECK(bounds().minimum == grVec2{-10, 5});
+        CHECK(bounds().maximum == grVec2{10, 10});
+
+        CHECK(draw.vertices[0].pos == grVec2{-10, 5});
+        CHECK(draw.vertices[2].pos == grVec2{10, 10});
+        CHECK(draw.vertices[26].pos == grVec2{130, 10});
+    }
+
+    for (grDrawList::Vertex const& vertex : draw.vertices) {
+        CHECK(vertex.uv.x >= 0.f);
+        CHECK(vertex.uv.x <= 1.f);
+        CHECK(vertex.rgba.r == 1);
+        CHECK(vertex.rgba.g == 2);
+        CHECK(vertex.rgba.b == 3);
+        CHECK(vertex.rgba.a == 4);
+    }
+    CHECK(draw.vertices[2].uv == grVec2{1, 1});
+}
+
+TEST_CASE("draw shapes", "[draw]") {
+    grCircleTable table;
+    grBuildCircleTable(table);
+
+    grDrawList draw;
+    draw.circleTable = &table;
+
+    SECTION("segment counts adapt to radius") {
+        CHECK(table.segmentsFor(1.f) < table.segmentsFor(10.f));
+        CHECK(table.segmentsFor(10.f) < table.segmentsFor(100.f));
+        CHECK(table.segmentsFor(100000.f) == grCircleTable::maxSegments);
+        CHECK(table.segmentsFor(10.f) % grCircleTable::segmentStep == 0);
+    }
+
+    SECTION("circle") {
+        std::size_t const segments = table.segmentsFor(20.f);
+        draw.drawCircle({50, 50}, 20.f, grColors::white);
+
+        REQUIRE(draw.vertices.size() == segments * 2);
+        REQUIRE(draw.indices.size() == (segments - 2) * 3 + segments * 6);
+        for (std::size_t index = 0; index != draw.vertices.size(); ++index) {
+            grDrawList::Vertex const& vertex = draw.vertices[index];
+            grVec2 const delta = vertex.pos - grVec2{50, 50};
+            float const distance = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+            if (index % 2 == 0) {
+                CHECK(distance == Approx(19.5f));
+                CHECK(vertex.rgba.a == 255);
+            }
+            else {
+                CHECK(distance == Approx(20.5f));
+                CHECK(vertex.rgba.a == 0);
+            }
+        }
+        for (grDrawList::Index index : draw.indices)
+            CHECK(index < draw.vertices.size());
+    }
+
+    SECTION("round rect") {
+        std::size_t const segments = table.segmentsFor(4.f);
+        draw.feather = 0.f;
+        draw.drawRoundRect({0, 0, 40, 20}, 4.f, grColors::white);
+
+        REQUIRE(draw.vertices.size() == segments + 4);
+        CHECK(draw.vertices[0].pos == grVec2{40, 16});
+        for (grDrawList::Vertex const& vertex : draw.vertices) {
+            CHECK(vertex.pos.x >= 0.f);
+            CHECK(vertex.pos.x <= 40.f);
+            CHECK(vertex.pos.y >= 0.f);
+            CHECK(vertex.pos.y <= 20.f);
+        }
+    }
+
+    SECTION("line") {
+        draw.drawLine({0, 0}, {10, 0}, grColors::white, 3.f);
+
+        REQUIRE(draw.vertices.size() == 8);
+        REQUIRE(draw.indices.size() == 18);
+        CHECK(draw.vertices[0].pos == grVec2{0, 2});
+        CHECK(draw.vertices[0].rgba.a == 0);
+        CHECK(draw.vertices[1].pos == grVec2{0, 1});
+        CHECK(draw.vertices[1].rgba.a == 255);
+        CHECK(draw.vertices[6].pos == grVec2{10, -1});
+    }
+
+    SECTION("closed polyline") {
+        grVec2 const square[4] = {{0, 0}, {10, 0}, {10, 10}, {0, 10}};
+        draw.feather = 0.f;
+        draw.drawPolyline(square, 4, grColors::white, 2.f, true);
+
+        REQUIRE(draw.vertices.size() == 8);
+        REQUIRE(draw.indices.size() == 24);
+        // mitered corners stay one unit from both edges
+        CHECK(draw.vertices[0].pos.x == Approx(1.f));
+        CHECK(draw.vertices[0].pos.y == Approx(1.f));
+        CHECK(draw.vertices[1].pos.x == Approx(-1.f));
+        CHECK(draw.vertices[1].pos.y == Approx(-1.f));
+    }
+}
+
+TEST_CASE("draw list layers", "[draw]") {
+    grDrawList draw;
+
+    draw.setLayer(grDrawLayer::Overlay);
+    draw.drawRect(7, {{0, 0}, {1, 1}}, {}, grColors::white);
+    draw.setLayer(grDrawLayer::Content);
+    draw.drawRect(5, {{1, 1}, {2, 2}}, {}, grColors::white);
+    draw.setLayer(grDrawLayer::Background);
+    draw.drawRect(6, {{2, 2}, {3, 3}}, {}, grColors::white);
+    draw.drawRect(6, {{3, 3}, {4, 4}}, {}, grColors::white);
+    draw.setLayer(grDrawLayer::Content);
+    draw.drawRect(5, {{4, 4}, {5, 5}}, {}, grColors::white);
+
+    REQUIRE(draw.indices.size() == 12);
+    REQUIRE(draw.commands.size() == 1);
+
+    draw.setLayer(grDrawLayer::Overlay);
+    draw.finalize();
+    CHECK(draw.layer == grDrawLayer::Content);
+
+    REQUIRE(draw.indices.size() == 30);
+    REQUIRE(draw.commands.size() == 3);
+
+    CHECK(draw.commands[0].textureId == 6);
+    CHECK(draw.commands[0].indexStart == 0);
+    CHECK(draw.commands[0].indexCount == 12);
+    CHECK(draw.commands[1].textureId == 5);
+    CHECK(draw.commands[1].indexStart == 12);
+    CHECK(draw.commands[1].indexCount == 12);
+    CHECK(draw.commands[2].textureId == 7);
+    CHECK(draw.commands[2].indexStart == 24);
+    CHECK(draw.commands[2].indexCount == 6);
+
+    // indices still refer to the vertices recorded in submission order
+    CHECK(draw.vertices[draw.indices[0]].pos == grVec2{2, 2});
+    CHECK(draw.vertices[draw.indices[12]].pos == grVec2{1, 1});
+    CHECK(draw.vertices[draw.indices[24]].pos == grVec2{0, 0});
+
+    SECTION("matching textures share a command") {
+        draw.reset();
+        draw.setLayer(grDrawLayer::Background);
+        draw.drawRect(5, {{0, 0}, {1, 1}}, {}, grColors::white);
+        draw.setLayer(grDrawLayer::Content);
+        draw.drawRect(5, {{1, 1}, {2, 2}}, {}, grColors::white);
+        draw.finalize();
+
+        REQUIRE(draw.commands.size() == 1);
+        CHECK(draw.commands[0].indexCount == 12);
+    }
+}
+
+TEST_CASE("draw list layers in caller blocks", "[draw]") {
+    struct Blocks {
+        grDrawList::Vertex vertices[8];
+        grDrawList::Index indices[12];
+        int requests = 0;
+        grVec2 firstDrawn;
+    } blocks;
+
+    grDrawList draw;
+    draw.blockUserData = &blocks;
+    draw.blockCallback = [](void* userData, grDrawList const& draw) {
+        auto& blocks = *static_cast<Blocks*>(userData);
+        if (!draw.indices.empty())
+            blocks.firstDrawn = draw.vertices[draw.indices[0]].pos;
+
+        ++blocks.requests;
+        return grDrawList::Block{blocks.vertices, blocks.indices, 8, 12};
+    };
+
+    draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    draw.setLayer(grDrawLayer::Background);
+    draw.drawRect({{1, 1}, {2, 2}}, grColors::white);
+    REQUIRE(blocks.requests == 1);
+
+    // the block is full across both layers, so the next rect hands it off merged
+    draw.drawRect({{2, 2}, {3, 3}}, grColors::white);
+    REQUIRE(blocks.requests == 2);
+    CHECK(blocks.firstDrawn == grVec2{1, 1});
+    CHECK(draw.layer == grDrawLayer::Background);
+
+    draw.finalize();
+    REQUIRE(draw.indices.data() == blocks.indices);
+    CHECK(draw.indices.size() == 6);
+}
+
+TEST_CASE("draw list layers in streamed chunks", "[draw]") {
+    grArray<grVec2> drawn;
+
+    grDrawList draw;
+    draw.chunkVertices = 8;
+    draw.flushUserData = &drawn;
+    draw.flushCallback = [](void* userData, grDrawList const& draw) {
+        auto& drawn = *static_cast<grArray<grVec2>*>(userData);
+        for (std::size_t index = 0; index < draw.indices.size(); index += 6)
+            drawn.push_back(draw.vertices[draw.indices[index]].pos);
+    };
+
+    draw.setLayer(grDrawLayer::Overlay);
+    draw.drawRect({{1, 1}, {2, 2}}, grColors::white);
+    draw.setLayer(grDrawLayer::Content);
+    draw.drawRect({{2, 2}, {3, 3}}, grColors::white);
+    draw.drawRect({{3, 3}, {4, 4}}, grColors::white);
+    draw.flush();
+
+    // the overlay stacks above content in its own chunk, but not above later chunks
+    REQUIRE(drawn.size() == 3);
+    CHECK(drawn[0] == grVec2{2, 2});
+    CHECK(drawn[1] == grVec2{1, 1});
+    CHECK(drawn[2] == grVec2{3, 3});
+}
+
+TEST_CASE("draw list uniform color", "[draw]") {
+    grDrawList draw;
+    draw.uniformColor = true;
+
+    grRect const rects[4] = {
+        {{0, 0}, {1, 1}},
+        {{1, 1}, {2, 2}},
+        {{2, 2}, {3, 3}},
+        {{3, 3}, {4, 4}},
+    };
+    grColor const colors[4] = {grColors::red, grColors::red, grColors::blue, grColors::blue};
+    draw.drawRects(rects, colors, 4);
+
+    CHECK(draw.vertices.empty());
+    REQUIRE(draw.compactVertices.size() == 16);
+    CHECK(draw.compactVertices[10].pos == grVec2{3, 3});
+
+    REQUIRE(draw.commands.size() == 2);
+    CHECK(draw.commands[0].color == grColors::red);
+    CHECK(draw.commands[0].indexCount == 12);
+    CHECK(draw.commands[1].color == grColors::blue);
+    CHECK(draw.commands[1].indexStart == 12);
+
+    SECTION("same color continues the command") {
+        draw.drawRect({{4, 4}, {5, 5}}, grColors::blue);
+        REQUIRE(draw.commands.size() == 2);
+        CHECK(draw.commands[1].indexCount == 18);
+    }
+
+    SECTION("shapes have no fringe") {
+        grCircleTable table;
+        grBuildCircleTable(table);
+
+        draw.drawCircle({10, 10}, 4, grColors::green);
+        REQUIRE(draw.commands.size() == 3);
+        CHECK(draw.commands[2].color == grColors::green);
+        CHECK(draw.compactVertices.size() == 16 + static_cast<std::size_t>(table.segmentsFor(4)));
+    }
+
+    SECTION("translate") {
+        draw.translate({10, 20}, 4);
+        CHECK(draw.compactVertices[0].pos == grVec2{0, 0});
+        CHECK(draw.compactVertices[4].pos == grVec2{11, 21});
+        CHECK(draw.compactVertices[6].uv == grVec2{0, 0});
+    }
+}
+
+TEST_CASE("draw list texture slots", "[draw]") {
+    grDrawList draw;
+    draw.textureSlots = 2;
+
+    draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    draw.drawRect(3, {{1, 1}, {2, 2}}, {}, grColors::white);
+    draw.drawRect(4, {{2, 2}, {3, 3}}, {}, grColors::white);
+    draw.drawRect(3, {{3, 3}, {4, 4}}, {}, grColors::white);
+
+    REQUIRE(draw.commands.size() == 1);
+    grDrawList::Command const& cmd = draw.commands[0];
+    CHECK(cmd.indexCount == 24);
+    REQUIRE(cmd.textureCount == 2);
+    CHECK(cmd.textureId == 3);
+    CHECK(draw.textures(cmd)[0] == 3);
+    CHECK(draw.textures(cmd)[1] == 4);
+
+    REQUIRE(draw.vertexSlots.size() == draw.vertices.size());
+    CHECK(draw.vertexSlots[0] == 0);
+    CHECK(draw.vertexSlots[4] == 0);
+    CHECK(draw.vertexSlots[8] == 1);
+    CHECK(draw.vertexSlots[15] == 0);
+
+    SECTION("a full command starts another") {
+        draw.drawRect(5, {{4, 4}, {5, 5}}, {}, grColors::white);
+
+        REQUIRE(draw.commands.size() == 2);
+        CHECK(draw.commands[1].textureCount == 1);
+        CHECK(draw.textures(draw.commands[1])[0] == 5);
+        CHECK(draw.vertexSlots.back() == 0);
+    }
+
+    SECTION("a changed slot is damaged") {
+        grDrawList previous;
+        previous.textureSlots = 2;
+        previous.drawRect(3, {{0, 0}, {1, 1}}, {}, grColors::white);
+        previous.drawRect(4, {{1, 1}, {2, 2}}, {}, grColors::white);
+        previous.drawRect(3, {{2, 2}, {3, 3}}, {}, grColors::white);
+
+        // same vertices, indices and texture set, only the last two rects swap textures
+        grDrawList current;
+        current.textureSlots = 2;
+        current.drawRect(3, {{0, 0}, {1, 1}}, {}, grColors::white);
+        current.drawRect(3, {{1, 1}, {2, 2}}, {}, grColors::white);
+        current.drawRect(4, {{2, 2}, {3, 3}}, {}, grColors::white);
+
+        grArray<grRect> damage;
+        grAppendDamage(previous, current, damage);
+        grMergeDamage(damage, 1);
+        REQUIRE(damage.size() == 1);
+        CHECK(damage[0].minimum == grVec2{1, 1});
+        CHECK(damage[0].maximum == grVec2{3, 3});
+    }
+}
+
+TEST_CASE("draw list texture slots across layers", "[draw]") {
+    grDrawList draw;
+    draw.textureSlots = 2;
+
+    draw.drawRect(3, {{0, 0}, {1, 1}}, {}, grColors::white);
+    draw.setLayer(grDrawLayer::Overlay);
+    draw.drawRect(4, {{1, 1}, {2, 2}}, {}, grColors::white);
+    draw.setLayer(grDrawLayer::Content);
+    draw.drawRect(5, {{2, 2}, {3, 3}}, {}, grColors::white);
+    draw.finalize();
+
+    // each command keeps its own set although the layers interleaved their textures
+    REQUIRE(draw.commands.size() == 2);
+    REQUIRE(draw.commands[0].textureCount == 2);
+    CHECK(draw.textures(draw.commands[0])[0] == 3);
+    CHECK(draw.textures(draw.commands[0])[1] == 5);
+    REQUIRE(draw.commands[1].textureCount == 1);
+    CHECK(draw.textures(draw.commands[1])[0] == 4);
+}
+
+TEST_CASE("draw list callbacks", "[draw]") {
+    grDrawList draw;
+    int calls = 0;
+    auto const callback = [](void* userData, grDrawList const&, grDrawList::Command const&) {
+        ++*static_cast<int*>(userData);
+    };
+
+    draw.drawRect({{0, 0}, {1, 1}}, grColors::white);
+    draw.drawCallback(callback, &calls, {{10, 10}, {20, 20}});
+    draw.drawRect({{1, 1}, {2, 2}}, grColors::white);
+
+    REQUIRE(draw.commands.size() == 3);
+    CHECK(draw.commands[0].indexCount == 6);
+    CHECK(draw.commands[1].callback != nullptr);
+    CHECK(draw.commands[1].indexStart == 6);
+    CHECK(draw.commands[1].indexCount == 0);
+    CHECK(draw.commands[2].indexStart == 6);
+    CHECK(draw.commands[2].indexCount == 6);
+
+    draw.finalize();
+    REQUIRE(draw.commands.size() == 3);
+
+    for (grDrawList::Command const& cmd : draw.commands) {
+        if (cmd.callback != nullptr)
+            cmd.callback(cmd.callbackUserData, draw, cmd);
+    }
+    CHECK(calls == 1);
+
+    SECTION("callback area is always damaged") {
+        grDrawList previous;
+        previous.copyGeometry(draw);
+
+        grArray<grRect> damage;
+        grAppendDamage(previous, draw, damage);
+        grMergeDamage(damage, 8);
+        REQUIRE(damage.size() == 1);
+        CHECK(damage[0].minimum == grVec2{10, 10});
+        CHECK(damage[0].maximum == grVec2{20, 20});
+    }
+}
+
+TEST_CASE("draw text runs", "[draw]") {
+    auto [result, ctx] = grCreateContext();
+    auto [status, fontId] = grCreateDefaultFont(ctx);
+    REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+    grFont const* font = grGetFont(ctx, fontId);
+
+    grStringView const text = "Hello, \xC3\xA9 world";
+
+    grTextRun run;
+    grFontLayoutText(font, text, run);
+    CHECK(run.size == grFontMeasureText(ctx, fontId, text));
+    REQUIRE(run.glyphs.size() == run.pens.size());
+
+    // a run draws exactly what drawText draws for the same text
+    grDrawList expected;
+    expected.drawText(font, 1, {10, 20}, grColors::white, text);
+    grDrawList draw;
+    draw.drawTextRun(1, {10, 20}, grColors::white, run);
+
+    REQUIRE(draw.vertices.size() == expected.vertices.size());
+    REQUIRE(draw.indices.size() == expected.indices.size());
+    for (std::size_t index = 0; index != draw.vertices.size(); ++index) {
+        CHECK(draw.vertices[index].pos == expected.vertices[index].pos);
+        CHECK(draw.vertices[index].uv == expected.vertices[index].uv);
+    }
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("draw cached text", "[draw]") {
+    auto [result, ctx] = grCreateContext();
+    auto [status, fontId] = grCreateDefaultFont(ctx);
+    REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+    grFont const* font = grGetFont(ctx, fontId);
+
+    grStringView const text = "Cached \xC3\xA9 label";
+
+    // text is only cached once it is seen again in a later frame
+    CHECK(grFontGetCachedText(ctx, fontId, text) == nullptr);
+    grBeginFrame(ctx, 0.f);
+    grEndFrame(ctx);
+
+    grCachedText const* cached = grFontGetCachedText(ctx, fontId, text);
+    REQUIRE(cached != nullptr);
+    CHECK(cached->size == grFontMeasureText(ctx, fontId, text));
+    CHECK(grFontGetCachedText(ctx, fontId, text) == cached);
+
+    SECTION("matches drawText") {
+        grDrawList expected;
+        expected.drawText(font, 1, {10.5f, 20}, grColors::red, text);
+        grDrawList draw;
+        draw.drawCachedText(1, {10.5f, 20}, grColors::red, *cached);
+
+        REQUIRE(draw.vertices.size() == expected.vertices.size());
+        REQUIRE(draw.indices.size() == expected.indices.size());
+        for (std::size_t index = 0; index != draw.vertices.size(); ++index) {
+            CHECK(draw.vertices[index].pos == expected.vertices[index].pos);
+            CHECK(draw.vertices[index].uv == expected.vertices[index].uv);
+            CHECK(draw.vertices[index].rgba == grColors::red);
+        }
+        for (std::size_t index = 0; index != draw.indices.size(); ++index)
+            CHECK(draw.indices[index] == expected.indices[index]);
+    }
+
+    SECTION("uniform color") {
+        grDrawList expected;
+        expected.uniformColor = true;
+        expected.drawText(font, 1, {3, 4}, grColors::red, text);
+        grDrawList draw;
+        draw.uniformColor = true;
+        draw.drawCachedText(1, {3, 4}, grColors::red, *cached);
+
+        REQUIRE(draw.compactVertices.size() == expected.compactVertices.size());
+        for (std::size_t index = 0; index != draw.compactVertices.size(); ++index)
+            CHECK(draw.compactVertices[index].pos == expected.compactVertices[index].pos);
+        REQUIRE(draw.commands.size() == 1);
+        CHECK(draw.commands[0].color == grColors::red);
+    }
+
+    SECTION("rebuilding the atlas drops cached quads") {
+        grCreateDefaultFont(ctx);
+        REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+        CHECK(ctx->textCache->entries.empty());
+    }
+
+    grDestroyContext(ctx);
+}
@@ -0,0 +1,448 @@
+// goober - by Sean Middleditch
+// This is free and unencumbered software released into the public domain.
+// See LICENSE.md for more details.
+
+#include "catch.hpp"
+#include "goober/font.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+TEST_CASE("glyph lookup", "[font]") {
+    grFont font;
+    for (int index = 0; index != 8; ++index)
+        font.glyphs.push_back({index, 1.f, {}, {}});
+
+    // deliberately out of order; lookup sorts them
+    font.glyphRanges.push_back({0x400, 2, 4});
+    font.glyphRanges.push_back({'A', 2, 0});
+    font.glyphRanges.push_back({0x300, 2, 2});
+    font.glyphRanges.push_back({0x10000, 2, 6});
+    grFontBuildGlyphLookup(&font);
+
+    SECTION("direct table") {
+        REQUIRE(grFontGetGlyph(&font, 'A') != nullptr);
+        CHECK(grFontGetGlyph(&font, 'A')->codepoint == 0);
+        CHECK(grFontGetGlyph(&font, 'B')->codepoint == 1);
+        CHECK(grFontGetGlyph(&font, '@') == nullptr);
+        CHECK(grFontGetGlyph(&font, 'C') == nullptr);
+        CHECK(grFontGetGlyph(&font, -1) == nullptr);
+    }
+
+    SECTION("ranges") {
+        REQUIRE(grFontGetGlyph(&font, 0x301) != nullptr);
+        CHECK(grFontGetGlyph(&font, 0x301)->codepoint == 3);
+        CHECK(grFontGetGlyph(&font, 0x400)->codepoint == 4);
+        CHECK(grFontGetGlyph(&font, 0x10001)->codepoint == 7);
+        CHECK(grFontGetGlyph(&font, 0x2FF) == nullptr);
+        CHECK(grFontGetGlyph(&font, 0x302) == nullptr);
+        CHECK(grFontGetGlyph(&font, 0x10002) == nullptr);
+    }
+}
+
+TEST_CASE("utf-8 decoding", "[font]") {
+    auto const decode = [](grStringView text) {
+        char const* it = text.begin();
+        int const codepoint = grDecodeUtf8(it, text.end());
+        return std::make_pair(codepoint, static_cast<int>(it - text.begin()));
+    };
+
+    CHECK(decode("A") == std::make_pair(int{'A'}, 1));
+    CHECK(decode("\xC3\xA9") == std::make_pair(0xE9, 2));
+    CHECK(decode("\xE2\x82\xAC") == std::make_pair(0x20AC, 3));
+    CHECK(decode("\xF0\x9F\x98\x80") == std::make_pair(0x1F600, 4));
+
+    // malformed: overlong, surrogate, truncated, stray continuation, bad continuation
+    CHECK(decode("\xC0\x80") == std::make_pair(0xFFFD, 1));
+    CHECK(decode("\xE0\x80\x80") == std::make_pair(0xFFFD, 1));
+    CHECK(decode("\xED\xA0\x80") == std::make_pair(0xFFFD, 1));
+    CHECK(decode("\xE2\x82") == std::make_pair(0xFFFD, 1));
+    CHECK(decode("\x80") == std::make_pair(0xFFFD, 1));
+    CHECK(decode("\xC3" "A") == std::make_pair(0xFFFD, 1));
+}
+
+TEST_CASE("glyph runs", "[font]") {
+    grFont font;
+    for (int index = 0; index != 4; ++index)
+        font.glyphs.push_back({index, 1.f, {}, {}});
+    font.glyphRanges.push_back({'a', 2, 0});
+    font.glyphRanges.push_back({0xE9, 1, 2});
+    font.glyphRanges.push_back({0x20AC, 1, 3});
+    grFontBuildGlyphLookup(&font);
+
+    // long ASCII runs take the block path, with unmapped bytes in the middle of blocks
+    char text[128] = {};
+    int expected[128] = {};
+    int expectedCount = 0;
+    int length = 0;
+    for (int index = 0; index != 70; ++index) {
+        char const ch = "abz"[index % 3];
+        text[length++] = ch;
+        if (ch != 'z')
+            expected[expectedCount++] = ch - 'a';
+    }
+    for (char const ch : {'\xC3', '\xA9', '\xE2', '\x82', '\xAC', '\xFF', 'b'})
+        text[length++] = ch;
+    expected[expectedCount++] = 2;
+    expected[expectedCount++] = 3;
+    expected[expectedCount++] = 1;
+
+    std::uint32_t glyphs[128];
+    char const* it = text;
+    std::size_t const count = grFontGetGlyphs(&font, it, text + length, glyphs, 128);
+    CHECK(it == text + length);
+    REQUIRE(count == static_cast<std::size_t>(expectedCount));
+    for (std::size_t index = 0; index != count; ++index)
+        CHECK(font.glyphs[glyphs[index]].codepoint == expected[index]);
+
+    SECTION("monospace detection") {
+        CHECK(font.monospaceAdvance == 1.f);
+        CHECK_FALSE(font.hasPrintableAscii);
+
+        font.glyphs[1].xAdvance = 2.f;
+        grFontBuildGlyphLookup(&font);
+        CHECK(font.monospaceAdvance == 0.f);
+    }
+
+    SECTION("output limit") {
+        it = text;
+        CHECK(grFontGetGlyphs(&font, it, text + length, glyphs, 5) == 5);
+        CHECK(it == text + 7);
+    }
+}
+
+TEST_CASE("default font glyphs", "[font]") {
+    auto [result, ctx] = grCreateContext();
+    auto [status, fontId] = grCreateDefaultFont(ctx);
+    REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+
+    grFont const* font = grGetFont(ctx, fontId);
+    CHECK(grFontGetGlyph(font, '\n') == nullptr);
+    REQUIRE(grFontGetGlyph(font, 'x') != nullptr);
+    CHECK(grFontGetGlyph(font, 'x')->codepoint == 'x');
+    REQUIRE(grFontGetGlyph(font, 0xE9) != nullptr);
+    CHECK(grFontGetGlyph(font, 0xE9)->codepoint == 0xE9);
+    CHECK(grFontGetGlyph(font, 0x1234) == nullptr);
+
+    CHECK(font->hasPrintableAscii);
+    REQUIRE(font->monospaceAdvance > 0.f);
+    CHECK(grFontMeasureText(ctx, fontId, "hello").x == 5 * font->monospaceAdvance);
+
+    // characters without glyphs do not advance; malformed bytes do not read past the end
+    grVec2 const ascii = grFontMeasureText(ctx, fontId, "xx");
+    CHECK(grFontMeasureText(ctx, fontId, "x\xE1\x88\xB4x").x == ascii.x);
+    CHECK(grFontMeasureText(ctx, fontId, "xx\xE1").x == ascii.x);
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("text measure cache", "[font]") {
+    auto [result, ctx] = grCreateContext();
+    auto [status, fontId] = grCreateDefaultFont(ctx);
+    REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+
+    grTextCache const& cache = *ctx->textCache;
+
+    // strings are cached once they are seen again in a later frame
+    grBeginFrame(ctx, 0.f);
+    grVec2 const first = grFontMeasureText(ctx, fontId, "ab");
+    grVec2 const second = grFontMeasureText(ctx, fontId, "abcd");
+    CHECK(second.x > first.x);
+    CHECK(grFontMeasureText(ctx, fontId, "ab\xE1\x88") == first);
+    CHECK(grFontMeasureText(ctx, fontId, "ab") == first);
+    CHECK(cache.entries.empty());
+    grEndFrame(ctx);
+
+    grBeginFrame(ctx, 0.f);
+    CHECK(grFontMeasureText(ctx, fontId, "ab") == first);
+    CHECK(grFontMeasureText(ctx, fontId, "abcd") == second);
+    CHECK(cache.entries.size() == 2);
+
+    // same-length strings are told apart by their contents
+    CHECK(grFontMeasureText(ctx, fontId, "ab") == first);
+    CHECK(grFontMeasureText(ctx, fontId, "ab\xE1\x88") == first);
+    CHECK(cache.entries.size() == 3);
+    grEndFrame(ctx);
+
+    SECTION("changing text is not cached") {
+        char label[16];
+        for (int frame = 0; frame != 100; ++frame) {
+            grBeginFrame(ctx, 0.f);
+            for (int index = 0; index != 100; ++index) {
+                std::snprintf(label, sizeof(label), "%d:%d", frame, index);
+                grFontMeasureText(ctx, fontId, label);
+            }
+            grEndFrame(ctx);
+        }
+        CHECK(cache.entries.size() <= 3);
+    }
+
+    SECTION("unused entries age out") {
+        for (std::uint64_t frame = 0; frame != cache.maxAge * 2; ++frame) {
+            grBeginFrame(ctx, 0.f);
+            CHECK(grFontMeasureText(ctx, fontId, "ab") == first);
+            grEndFrame(ctx);
+        }
+        CHECK(cache.entries.size() == 1);
+    }
+
+    SECTION("rebuilding fonts clears the cache") {
+        grCreateDefaultFont(ctx);
+        REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+        CHECK(cache.entries.empty());
+        CHECK(grFontMeasureText(ctx, fontId, "abcd") == second);
+    }
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("split glyph arrays", "[font]") {
+    grFont font;
+    font.glyphs.push_back({'a', 3.5f, {{0.5f, -7.f}, {3.f, 1.03f}}, {{0, 0}, {0.5f, 0.5f}}});
+    font.glyphRanges.push_back({'a', 1, 0});
+    grFontBuildGlyphLookup(&font);
+
+    REQUIRE(font.advances.size() == 1);
+    CHECK(font.advances[0] == 3.5f);
+    CHECK(font.texCoords[0].maximum == font.glyphs[0].texCoord.maximum);
+
+    // extents are rounded to sixteenths, and the record follows
+    CHECK(font.extents[0].left == 8);
+    CHECK(font.extents[0].top == -112);
+    CHECK(font.extents[0].bottom == 16);
+    CHECK(font.glyphs[0].extent.maximum.y == 1.f);
+    CHECK(font.extents[0].rect().minimum == font.glyphs[0].extent.minimum);
+}
+
+// copies the pixels of a glyph out of the atlas
+static grArray<unsigned char> glyphPixels(grFontAtlas const& atlas, grGlyph const& glyph) {
+    int const x = static_cast<int>(glyph.texCoord.minimum.x * atlas.width + 0.5f);
+    int const y = static_cast<int>(glyph.texCoord.minimum.y * atlas.height + 0.5f);
+    int const width = static_cast<int>(glyph.extent.size().x + 0.5f);
+    int const height = static_cast<int>(glyph.extent.size().y + 0.5f);
+
+    grArray<unsigned char> pixels;
+    for (int row = 0; row != height; ++row) {
+        for (int column = 0; column != width; ++column)
+            pixels.push_back(atlas.data[(y + row) * atlas.width + x + column]);
+    }
+    return pixels;
+}
+
+TEST_CASE("dynamic font atlas", "[font]") {
+    auto [result, ctx] = grCreateContext();
+    auto [status, fontId] = grCreateDefaultFont(ctx);
+    REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+
+    grGlyph const baked = *grFontGetGlyph(ctx, fontId, 'A');
+    float const bakedWidth = static_cast<float>(ctx->fontAtlas->width);
+    float const bakedHeight = static_cast<float>(ctx->fontAtlas->height);
+
+    REQUIRE(grSetFontAtlasDynamic(ctx, true, 64) == grStatus::Ok);
+    grFont const* font = grGetFont(ctx, fontId);
+    CHECK(font->glyphs.empty());
+
+    SECTION("glyphs are added on first lookup") {
+        grGlyph const* glyph = grFontGetGlyph(ctx, fontId, 'A');
+        REQUIRE(glyph != nullptr);
+        CHECK(font->glyphs.size() == 1);
+        CHECK(grFontGetGlyph(ctx, fontId, 'A') == glyph);
+        CHECK(font->glyphs.size() == 1);
+
+        CHECK(glyph->xAdvance == baked.xAdvance);
+        CHECK(glyph->extent.size() == baked.extent.size());
+        CHECK(glyph->texCoord.size().x * 64.f == Approx(baked.texCoord.size().x * bakedWidth));
+        CHECK(glyph->texCoord.size().y * 64.f == Approx(baked.texCoord.size().y * bakedHeight));
+        CHECK(grFontGetGlyph(ctx, fontId, '\n') == nullptr);
+
+        grFontAtlas const* atlas = grGetFontAtlasIfDirtyAlpha8(ctx);
+        REQUIRE(atlas != nullptr);
+        CHECK(atlas->width == 64);
+        CHECK(atlas->data[0] == 0xFF);
+    }
+
+    // fills the atlas with printable ASCII in order, returning the first that did not fit
+    auto const fill = [context = ctx, id = fontId](int from) {
+        for (int codepoint = from; codepoint != '~'; ++codepoint) {
+            if (grFontGetGlyph(context, id, codepoint) == nullptr)
+                return codepoint;
+        }
+        return 0;
+    };
+
+    SECTION("glyphs unused last frame are evicted") {
+        grFontAtlas const& atlas = *ctx->fontAtlas;
+        ctx->fontAtlas->maxSize = 64;
+
+        grBeginFrame(ctx, 0.f);
+        int const missing = fill('!');
+        REQUIRE(missing != 0);
+        CHECK(atlas.full);
+        grEndFrame(ctx);
+
+        // everything was used, so the page is packed with the same glyphs again
+        grBeginFrame(ctx, 0.f);
+        CHECK(atlas.width == 64);
+        CHECK(atlas.droppedGlyphs == 0);
+        CHECK_FALSE(atlas.full);
+        std::size_t const resident = font->glyphs.size();
+        grArray<unsigned char> const pixels = glyphPixels(atlas, *grFontGetGlyph(ctx, fontId, '#'));
+        int const stillMissing = fill(missing);
+        REQUIRE(stillMissing != 0);
+        std::size_t const added = font->glyphs.size() - resident;
+        grEndFrame(ctx);
+
+        grBeginFrame(ctx, 0.f);
+        CHECK(font->glyphs.size() == 1 + added);
+        grGlyph const* kept = grFontGetGlyph(ctx, fontId, '#');
+        REQUIRE(kept != nullptr);
+        grArray<unsigned char> const moved = glyphPixels(atlas, *kept);
+        REQUIRE(moved.size() == pixels.size());
+        CHECK(std::equal(moved.begin(), moved.end(), pixels.begin()));
+        CHECK(grFontGetGlyph(ctx, fontId, stillMissing) != nullptr);
+        grEndFrame(ctx);
+    }
+
+    SECTION("cached text keeps its glyphs") {
+        grFontAtlas const& atlas = *ctx->fontAtlas;
+        ctx->fontAtlas->maxSize = 64;
+
+        grBeginFrame(ctx, 0.f);
+        CHECK(grFontGetCachedText(ctx, fontId, "#$%") == nullptr);
+        grEndFrame(ctx);
+
+        grBeginFrame(ctx, 0.f);
+        grCachedText const* cached = grFontGetCachedText(ctx, fontId, "#$%");
+        REQUIRE(cached != nullptr);
+        grEndFrame(ctx);
+
+        // the label is only drawn from the cache while other text fills the page
+        grBeginFrame(ctx, 0.f);
+        CHECK(grFontGetCachedText(ctx, fontId, "#$%") == cached);
+        REQUIRE(fill('0') != 0);
+        CHECK(atlas.full);
+        grDrawList draw;
+        draw.drawCachedText(0, {0, 0}, grColors::white, *grFontGetCachedText(ctx, fontId, "#$%"));
+        CHECK(draw.indices.size() == 18);
+        grEndFrame(ctx);
+
+        grBeginFrame(ctx, 0.f);
+        CHECK(atlas.width == 64);
+        CHECK(font->directGlyphs['#'] != 0);
+        CHECK(font->directGlyphs['$'] != 0);
+        CHECK(font->directGlyphs['%'] != 0);
+        grEndFrame(ctx);
+    }
+
+    SECTION("full atlases grow") {
+        grFontAtlas const& atlas = *ctx->fontAtlas;
+
+        grBeginFrame(ctx, 0.f);
+        int const missing = fill('!');
+        REQUIRE(missing != 0);
+        grArray<unsigned char> const pixels = glyphPixels(atlas, *grFontGetGlyph(ctx, fontId, '#'));
+        grEndFrame(ctx);
+
+        // glyphs are kept whether or not they were used
+        std::size_t const resident = font->glyphs.size();
+        grBeginFrame(ctx, 0.f);
+        CHECK(atlas.width == 128);
+        CHECK(atlas.height == 64);
+        CHECK(font->glyphs.size() == resident);
+        grArray<unsigned char> const moved = glyphPixels(atlas, *grFontGetGlyph(ctx, fontId, '#'));
+        REQUIRE(moved.size() == pixels.size());
+        CHECK(std::equal(moved.begin(), moved.end(), pixels.begin()));
+        CHECK(fill(missing) == 0);
+        grEndFrame(ctx);
+
+        grFontAtlasStats const stats = grGetFontAtlasStats(ctx);
+        CHECK(stats.width == 128);
+        CHECK(stats.glyphCount == font->glyphs.size());
+        CHECK(stats.occupancy() > 0.f);
+        CHECK(stats.occupancy() < 1.f);
+    }
+
+    SECTION("only new glyphs need uploading") {
+        grFontAtlas const* atlas = grGetFontAtlasIfDirtyAlpha8(ctx);
+        REQUIRE(atlas != nullptr);
+        REQUIRE(atlas->dirtyRects.size() == 1);
+        CHECK(atlas->dirtyRects[0].size() == grVec2{64, 64});
+        grFontAtlasBindTexture(ctx, 1);
+        CHECK(grGetFontAtlasIfDirtyAlpha8(ctx) == nullptr);
+
+        grGlyph const* a = grFontGetGlyph(ctx, fontId, 'A');
+        grGlyph const* b = grFontGetGlyph(ctx, fontId, 'B');
+        REQUIRE(b != nullptr);
+        REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) == atlas);
+
+        // the areas cover only the new glyphs
+        grRect area = a->texCoord;
+        area.minimum = grVec2{std::fmin(area.minimum.x, b->texCoord.minimum.x),
+                              std::fmin(area.minimum.y, b->texCoord.minimum.y)} * 64.f;
+        area.maximum = grVec2{std::fmax(area.maximum.x, b->texCoord.maximum.x),
+                              std::fmax(area.maximum.y, b->texCoord.maximum.y)} * 64.f;
+        REQUIRE(atlas->dirtyRects.size() == 2);
+        for (grRect const& rect : atlas->dirtyRects) {
+            CHECK(rect.minimum.x >= area.minimum.x);
+            CHECK(rect.minimum.y >= area.minimum.y);
+            CHECK(rect.maximum.x <= area.maximum.x);
+            CHECK(rect.maximum.y <= area.maximum.y);
+            CHECK(rect.size().x * rect.size().y < 64.f * 64.f);
+        }
+
+        grFontAtlasBindTexture(ctx, 1);
+        CHECK(atlas->dirtyRects.empty());
+    }
+
+    SECTION("returning to a baked atlas") {
+        grFontGetGlyph(ctx, fontId, 'A');
+        REQUIRE(grSetFontAtlasDynamic(ctx, false) == grStatus::Ok);
+        REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+        CHECK(grFontGetGlyph(ctx, fontId, 'A')->texCoord.minimum == baked.texCoord.minimum);
+    }
+
+    grDestroyContext(ctx);
+}
+
+TEST_CASE("baked atlas sizing", "[font]") {
+    auto [result, ctx] = grCreateContext();
+    auto [status, fontId] = grCreateDefaultFont(ctx);
+    REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+
+    // one small font needs far less than a 512x512 atlas
+    grFontAtlasStats const single = grGetFontAtlasStats(ctx);
+    CHECK(single.width < 512);
+    CHECK(single.droppedGlyphs == 0);
+    CHECK(single.glyphCount == 190);
+    CHECK(single.occupancy() > 0.25f);
+
+    SECTION("larger fonts grow the atlas") {
+        for (int index = 0; index != 3; ++index) {
+            grFontId const id = grCreateDefaultFont(ctx).value;
+            ctx->fonts[id]->fontSize = 48.f;
+        }
+        REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+
+        grFontAtlasStats const stats = grGetFontAtlasStats(ctx);
+        CHECK(stats.width * stats.height > single.width * single.height);
+        CHECK(stats.droppedGlyphs == 0);
+        CHECK(stats.glyphCount == single.glyphCount * 4);
+        CHECK(grFontGetGlyph(ctx, 3, 'A') != nullptr);
+        CHECK(grFontGetGlyph(ctx, fontId, 'A') != nullptr);
+    }
+
+    SECTION("glyphs that do not fit are dropped") {
+        ctx->fontAtlas->maxSize = 64;
+        grCreateDefaultFont(ctx);
+        REQUIRE(grGetFontAtlasIfDirtyAlpha8(ctx) != nullptr);
+
+        grFontAtlasStats const stats = grGetFontAtlasStats(ctx);
+        CHECK(stats.width == 64);
+        CHECK(stats.droppedGlyphs > 0);
+        CHECK(stats.glyphCount + stats.droppedGlyphs == single.glyphCount * 2);
+    }
+
+    grDestroyContext(ctx);
+}
@@ -0,0 +1,130 @@
+// goober - by Sean Middleditch
+// This is free and unencumbered software released into the public domain.
+// See LICENSE.md for more details.
+
+#include "catch.hpp"
+#include "goober/core.hh"
+#include "goober/draw.hh"
+#include "goober/image.hh"
+#include "goober/widgets.hh"
+
+TEST_CASE("image atlas", "[image]") {
+    auto [result, ctx] = grCreateContext();
+    REQUIRE(result == grStatus::Ok);
+
+    unsigned char pixels[16 * 16 * 4];
+    for (unsigned char& byte : pixels)
+        byte = 0x7F;
+
+    SECTION("images share a page") {
+        auto const first = grAddImage(ctx, pixels, 8, 8);
+        auto const second = grAddImage(ctx, pixels, 4, 2);
+        REQUIRE(first.status == grStatus::Ok);
+        REQUIRE(second.status == grStatus::Ok);
+        CHECK(first.value != second.value);
+        REQUIRE(ctx->imageAtlas->pages.size() == 1);
+
+        grImageAtlasPage const* page = grGetImageAtlasPageIfDirty(ctx, 0);
+        REQUIRE(page != nullptr);
+        grImageAtlasBindTexture(ctx, 0, 42);
+        CHECK(grGetImageAtlasPageIfDirty(ctx, 0) == nullptr);
+
+        auto const region = grResolveImage(ctx, second.value);
+        REQUIRE(region.status == grStatus::Ok);
+        CHECK(region.value.texture == 42);
+
+        grVec2 const size = region.value.texCoord.size() * static_cast<float>(page->size);
+        CHECK(size == grVec2{4, 2});
+
+        grVec2 const corner = region.value.texCoord.minimum * static_cast<float>(page->size);
+        std::size_t const offset = (static_cast<std::size_t>(corner.y) * page->size +
+                                    static_cast<std::size_t>(corner.x)) * 4;
+        CHECK(page->pixels[offset] == 0x7F);
+    }
+
+    SECTION("invalid ids") {
+        CHECK(grResolveImage(ctx, 0).status == grStatus::InvalidId);
+        CHECK(grResolveImage(ctx, 7).status == grStatus::InvalidId);
+
+        auto const image = grAddImage(ctx, pixels, 8, 8);
+        CHECK(grRemoveImage(ctx, image.value) == grStatus::Ok);
+        CHECK(grResolveImage(ctx, image.value).status == grStatus::InvalidId);
+        CHECK(grRemoveImage(ctx, image.value) == grStatus::InvalidId);
+    }
+
+    SECTION("pages without a texture are not drawn") {
+        auto const image = grAddImage(ctx, pixels, 8, 8);
+
+        grBeginFrame(ctx, 0.f);
+        CHECK(grResolveImage(ctx, image.value).status == grStatus::Empty);
+        CHECK(ctx->animationDelay == 0.f);
+        grEndFrame(ctx);
+
+        REQUIRE(grGetImageAtlasPageIfDirty(ctx, 0) != nullptr);
+        grImageAtlasBindTexture(ctx, 0, 42);
+
+        grBeginFrame(ctx, 0.f);
+        auto const region = grResolveImage(ctx, image.value);
+        REQUIRE(region.status == grStatus::Ok);
+        CHECK(region.value.texture == 42);
+        grEndFrame(ctx);
+    }
+
+    SECTION("untextured geometry samples white") {
+        unsigned char const red[4] = {0xFF, 0, 0, 0xFF};
+        auto const image = grAddImage(ctx, red, 1, 1);
+        REQUIRE(grGetImageAtlasPageIfDirty(ctx, 0) != nullptr);
+        grImageAtlasBindTexture(ctx, 0, 42);
+
+        grBeginFrame(ctx, 0.f);
+        grBeginPortal(ctx, "test");
+        grImage(ctx, image.value, {{0, 0}, {10, 10}}, grColors::white);
+        grDrawList const& draw = *grCurrentDrawList(ctx);
+        std::size_t const imageVertices = draw.vertices.size();
+        grCurrentDrawList(ctx)->drawRect({{10, 10}, {20, 20}}, grColors::white);
+
+        // the rect joins the image's command and samples the page's reserved texel
+        REQUIRE(draw.commands.size() == 1);
+        CHECK(draw.commands[0].textureId == 42);
+        CHECK(draw.vertices[imageVertices].uv == grVec2{0, 0});
+        CHECK(ctx->imageAtlas->images[image.value - 1].texCoord.minimum != grVec2{0, 0});
+
+        unsigned char const* const pixel = ctx->imageAtlas->pages[0]->pixels;
+        CHECK(pixel[0] == 0xFF);
+        CHECK(pixel[1] == 0xFF);
+        CHECK(pixel[2] == 0xFF);
+        CHECK(pixel[3] == 0xFF);
+        grEndPortal(ctx);
+        grEndFrame(ctx);
+    }
+
+    SECTION("least recently drawn page is recycled") {
+        ctx->imageAtlas->pageSize = 16;
+        ctx->imageAtlas->maxPages = 2;
+
+        // each page fits only one 12x12 image once padding is added
+        auto const first = grAddImage(ctx, pixels, 12, 12);
+        auto const second = grAddImage(ctx, pixels, 12, 12);
+        auto const third = grAddImage(ctx, pixels, 12, 12);
+        REQUIRE(ctx->imageAtlas->pages.size() == 2);
+        CHECK(ctx->imageAtlas->images[third.value - 1].page == -1);
+        grImageAtlasBindTexture(ctx, 0, 42);
+        grImageAtlasBindTexture(ctx, 1, 43);
+
+        grBeginFrame(ctx, 0.f);
+        CHECK(grResolveImage(ctx, first.value).status == grStatus::Ok);
+        CHECK(grResolveImage(ctx, second.value).status == grStatus::Ok);
+        // both pages were drawn this frame, so nothing can be evicted
+        CHECK(grResolveImage(ctx, third.value).status == grStatus::BadAlloc);
+        grEndFrame(ctx);
+
+        grBeginFrame(ctx, 0.f);
+        CHECK(grResolveImage(ctx, second.value).status == grStatus::Ok);
+        CHECK(grResolveImage(ctx, third.value).status == grStatus::Ok);
+        CHECK(ctx->imageAtlas->images[third.value - 1].page == 0);
+        CHECK(ctx->imageAtlas->images[first.value - 1].page == -1);
+        grEndFrame(ctx);
+    }
+
+    grDestroyContext(ctx);
+}